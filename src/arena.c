@@ -0,0 +1,82 @@
+#include "include/arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t used;
+  size_t size;
+  max_align_t data[];
+};
+
+void arena_init(Arena *arena, size_t chunk_size) {
+  if (!arena)
+    return;
+  arena->head = NULL;
+  arena->chunk_size = chunk_size;
+}
+
+void *arena_alloc(Arena *arena, size_t size, size_t align) {
+  if (!arena)
+    return NULL;
+
+  ArenaChunk *chunk = arena->head;
+  if (chunk) {
+    size_t offset = (chunk->used + align - 1) & ~(align - 1);
+    if (offset + size <= chunk->size) {
+      chunk->used = offset + size;
+      return (char *)chunk->data + offset;
+    }
+  }
+
+  if (size > arena->chunk_size) {
+    /* Oversized request: a chunk of its own, linked behind the current one so
+     * the free space left there is not lost */
+    ArenaChunk *big = malloc(sizeof *big + size);
+    if (!big)
+      return NULL;
+    big->size = size;
+    big->used = size;
+    if (chunk) {
+      big->next = chunk->next;
+      chunk->next = big;
+    } else {
+      big->next = NULL;
+      arena->head = big;
+    }
+    return big->data;
+  }
+
+  /* Current chunk is full: start a new one */
+  chunk = malloc(sizeof *chunk + arena->chunk_size);
+  if (!chunk)
+    return NULL;
+  chunk->size = arena->chunk_size;
+  chunk->used = size;
+  chunk->next = arena->head;
+  arena->head = chunk;
+
+  return chunk->data;
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t len) {
+  char *copy = arena_alloc(arena, len + 1, 1);
+  if (!copy)
+    return NULL;
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+void arena_free(Arena *arena) {
+  if (!arena)
+    return;
+
+  ArenaChunk *chunk = arena->head;
+  while (chunk) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head = NULL;
+}
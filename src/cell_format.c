@@ -0,0 +1,193 @@
+/* src/cell_format.c */
+#include "include/cell_format.h"
+#include <string.h>
+#include <sys/stat.h>
+
+/* "00" "01" ... "99" */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343"
+    "53637383940414243444546474849505152535455565758596061626364656667686970"
+    "7172737475767778798081828384858687888990919293949596979899";
+
+/* rwx of the three classes for every value of mode & 0777 */
+#define PERM_TRIAD(t)                                                          \
+  ((t) & 4 ? 'r' : '-'), ((t) & 2 ? 'w' : '-'), ((t) & 1 ? 'x' : '-')
+#define PERM_RWX(m) {PERM_TRIAD((m) >> 6), PERM_TRIAD((m) >> 3), PERM_TRIAD(m)}
+#define PERM_RWX8(m)                                                           \
+  PERM_RWX(m), PERM_RWX(m + 1), PERM_RWX(m + 2), PERM_RWX(m + 3),              \
+      PERM_RWX(m + 4), PERM_RWX(m + 5), PERM_RWX(m + 6), PERM_RWX(m + 7)
+#define PERM_RWX64(m)                                                          \
+  PERM_RWX8(m), PERM_RWX8(m + 8), PERM_RWX8(m + 16), PERM_RWX8(m + 24),        \
+      PERM_RWX8(m + 32), PERM_RWX8(m + 40), PERM_RWX8(m + 48),                 \
+      PERM_RWX8(m + 56)
+
+static const char perm_rwx[512][9] = {
+    PERM_RWX64(0),   PERM_RWX64(64),  PERM_RWX64(128), PERM_RWX64(192),
+    PERM_RWX64(256), PERM_RWX64(320), PERM_RWX64(384), PERM_RWX64(448),
+};
+
+/* setuid, setgid, sticky as %S shows them, by (mode >> 9) & 7 */
+static const char perm_special[8][3] = {
+    {'-', '-', '-'}, {'-', '-', 't'}, {'-', 's', '-'}, {'-', 's', 't'},
+    {'s', '-', '-'}, {'s', '-', 't'}, {'s', 's', '-'}, {'s', 's', 't'},
+};
+
+/* File type letter by (mode & S_IFMT) >> 12 */
+static const char perm_type[16] = {
+    '?', 'p', 'c', '?', 'd', '?', 'b', '?',
+    '-', '?', 'l', '?', 's', '?', '?', '?',
+};
+
+size_t cell_format_u64(unsigned long long v, char *buf) {
+  int len = 1;
+  for (unsigned long long t = v; t >= 10; t /= 10)
+    len++;
+
+  char *p = buf + len;
+  *p = '\0';
+  while (v >= 100) {
+    unsigned i = (unsigned)(v % 100) * 2;
+    v /= 100;
+    *--p = digit_pairs[i + 1];
+    *--p = digit_pairs[i];
+  }
+  if (v >= 10) {
+    *--p = digit_pairs[v * 2 + 1];
+    *--p = digit_pairs[v * 2];
+  } else {
+    *--p = (char)('0' + v);
+  }
+  return (size_t)len;
+}
+
+/* v in tenths of 2^shift, rounded from the full value. v * 10 does not fit
+ * in 64 bits for the largest sizes, so the whole units and the remainder
+ * are scaled apart */
+static unsigned long long scaled_tenths(unsigned long long v, int shift) {
+  unsigned long long rem = v & ((1ULL << shift) - 1);
+  return (v >> shift) * 10 + ((rem * 10 + (1ULL << (shift - 1))) >> shift);
+}
+
+size_t cell_format_size(long long size, bool human, char *buf) {
+  if (size < 0) {
+    /* Not expected from stat, but keep it readable */
+    buf[0] = '-';
+    return 1 + cell_format_u64(0ULL - (unsigned long long)size, buf + 1);
+  }
+
+  unsigned long long v = (unsigned long long)size;
+  if (!human || v < 1024) {
+    size_t len = cell_format_u64(v, buf);
+    if (human) {
+      memcpy(buf + len, " B", 3);
+      len += 2;
+    }
+    return len;
+  }
+
+  static const char units[][4] = {"KiB", "MiB", "GiB", "TiB", "PiB", "EiB"};
+  int unit = 0;
+  while (unit < 5 && v >> (10 * (unit + 2)) != 0)
+    unit++;
+
+  /* Tenths of the unit, rounded */
+  unsigned long long tenths = scaled_tenths(v, 10 * (unit + 1));
+  if (tenths >= 10240 && unit < 5) {
+    unit++;
+    tenths = scaled_tenths(v, 10 * (unit + 1));
+  }
+
+  size_t len = cell_format_u64(tenths / 10, buf);
+  buf[len++] = '.';
+  buf[len++] = (char)('0' + tenths % 10);
+  buf[len++] = ' ';
+  memcpy(buf + len, units[unit], 4);
+  return len + 3;
+}
+
+/* rwx of mode with setuid, setgid and sticky embedded in the x positions
+ * (s/S, s/S, t/T) as ls shows them */
+static void perm_rwx_embedded(mode_t m, char out[9]) {
+  memcpy(out, perm_rwx[m & 0777], 9);
+  if (m & S_ISUID)
+    out[2] = out[2] == 'x' ? 's' : 'S';
+  if (m & S_ISGID)
+    out[5] = out[5] == 'x' ? 's' : 'S';
+  if (m & S_ISVTX)
+    out[8] = out[8] == 'x' ? 't' : 'T';
+}
+
+/* Fields of COL_PERM_FIELDS for template_expand() */
+static const char *perm_field(void *ctx, char field, char *scratch, size_t cap,
+                              size_t *len) {
+  mode_t m = *(const mode_t *)ctx;
+  const char *rwx = perm_rwx[m & 0777];
+
+  if (cap < 9)
+    return NULL;
+  *len = 3;
+  switch (field) {
+  case 'n':
+    /* Four octal digits, special bits first */
+    for (int i = 0; i < 4; i++)
+      scratch[i] = (char)('0' + ((m >> (9 - 3 * i)) & 7));
+    *len = 4;
+    return scratch;
+  case 'T':
+    *len = 1;
+    return &perm_type[(m & S_IFMT) >> 12];
+  case 'S':
+    return perm_special[(m >> 9) & 7];
+  case 'u':
+    return rwx;
+  case 'g':
+    return rwx + 3;
+  case 'o':
+    return rwx + 6;
+  case 'U':
+  case 'G':
+  case 'O':
+    perm_rwx_embedded(m, scratch);
+    return scratch + (field == 'U' ? 0 : field == 'G' ? 3 : 6);
+  default:
+    return NULL;
+  }
+}
+
+size_t cell_format_mode(mode_t mode, const Template *tpl, char *buf,
+                        size_t cap) {
+  return template_expand(tpl, buf, cap, perm_field, &mode);
+}
+
+size_t cell_format_mode_ls(mode_t mode, char *buf) {
+  buf[0] = perm_type[(mode & S_IFMT) >> 12];
+  memcpy(buf + 1, perm_rwx[mode & 0777], 9);
+  buf[10] = '\0';
+  return 10;
+}
+
+int cell_format_sizes(const long long *sizes, int count, bool human,
+                      char *text, size_t cap, size_t *offsets) {
+  size_t used = 0;
+  int i = 0;
+  for (; i < count && cap - used >= CELL_FORMAT_SIZE_MAX; i++) {
+    offsets[i] = used;
+    used += cell_format_size(sizes[i], human, text + used) + 1;
+  }
+  return i;
+}
+
+int cell_format_modes(const mode_t *modes, int count, const Template *tpl,
+                      char *text, size_t cap, size_t *offsets) {
+  size_t used = 0;
+  int i = 0;
+  for (; i < count && used < cap; i++) {
+    size_t avail = cap - used;
+    size_t len = cell_format_mode(modes[i], tpl, text + used, avail);
+    if (len + 1 == avail)
+      break; /* may be cut; left for the next call */
+    offsets[i] = used;
+    used += len + 1;
+  }
+  return i;
+}
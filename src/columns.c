@@ -1,6 +1,8 @@
 #include "include/columns.h"
+#include "include/cell_format.h"
 #include "include/config.h"
 #include "include/fileentry.h"
+#include "include/fs.h"
 #include <SDL3_ttf/SDL_ttf.h>
 #include <limits.h>
 #include <stdio.h>
@@ -20,38 +22,87 @@ ColumnRegistry *cols_create(void) {
   return reg;
 }
 
-void cols_add(ColumnRegistry *reg, ColumnDef col) {
+static void cols_release(ColumnDef *col) {
+  template_free(col->cell_tpl);
+  template_free(col->header_tpl);
+  date_format_free(col->date_fmt);
+  col->cell_tpl = NULL;
+  col->header_tpl = NULL;
+  col->date_fmt = NULL;
+}
+
+/* Compile the templates of a column being registered */
+static bool cols_compile(ColumnDef *col) {
+  const char *cell_src = NULL;
+  const char *cell_fields = NULL;
+
+  switch (col->type) {
+  case COL_PATH:
+    cell_src = col->cell_template ? col->cell_template : "%n";
+    cell_fields = COL_PATH_FIELDS;
+    break;
+  case COL_PERMS:
+    cell_src = col->cell_template ? col->cell_template : PERM_TEMPLATE;
+    cell_fields = COL_PERM_FIELDS;
+    break;
+  default:
+    break;
+  }
+
+  col->cell_tpl = template_compile(cell_src, cell_fields);
+  col->header_tpl = template_compile(col->header_template, FS_HEADER_FIELDS);
+  col->date_fmt = NULL;
+  if (col->type == COL_DATE)
+    col->date_fmt = date_format_create(
+        col->cell_template && col->cell_template[0] ? col->cell_template
+                                                    : DATE_FORMAT_TEMPLATE);
+  if ((cell_src && !col->cell_tpl) ||
+      (col->header_template && !col->header_tpl) ||
+      (col->type == COL_DATE && !col->date_fmt)) {
+    cols_release(col);
+    return false;
+  }
+  return true;
+}
+
+bool cols_add(ColumnRegistry *reg, ColumnDef col) {
   if (!reg)
-    return;
+    return false;
 
   if (reg->count >= reg->capacity) {
     int new_cap = reg->capacity == 0 ? 8 : reg->capacity * 2;
     ColumnDef *new_cols =
         realloc(reg->columns, (size_t)new_cap * sizeof *new_cols);
     if (!new_cols)
-      return;
+      return false;
     reg->columns = new_cols;
     reg->capacity = new_cap;
   }
 
+  if (!cols_compile(&col))
+    return false;
   reg->columns[reg->count] = col;
   reg->count++;
+  return true;
 }
 
-void cols_insert(ColumnRegistry *reg, int col_idx, ColumnDef col) {
+bool cols_insert(ColumnRegistry *reg, int col_idx, ColumnDef col) {
   if (!reg || col_idx < 0 || col_idx > reg->count)
-    return;
+    return false;
 
   if (reg->count >= reg->capacity) {
     int new_cap = reg->capacity == 0 ? 8 : reg->capacity * 2;
     ColumnDef *new_cols =
         realloc(reg->columns, (size_t)new_cap * sizeof *new_cols);
     if (!new_cols)
-      return;
+      return false;
     reg->columns = new_cols;
     reg->capacity = new_cap;
   }
 
+  if (!cols_compile(&col))
+    return false;
+
   /* Shift columns to the right */
   for (int i = reg->count; i > col_idx; i--) {
     reg->columns[i] = reg->columns[i - 1];
@@ -59,12 +110,14 @@ void cols_insert(ColumnRegistry *reg, int col_idx, ColumnDef col) {
 
   reg->columns[col_idx] = col;
   reg->count++;
+  return true;
 }
 
 void cols_remove(ColumnRegistry *reg, int col_idx) {
   if (!reg || col_idx < 0 || col_idx >= reg->count)
     return;
 
+  cols_release(&reg->columns[col_idx]);
   for (int i = col_idx; i < reg->count - 1; i++) {
     reg->columns[i] = reg->columns[i + 1];
   }
@@ -100,136 +153,163 @@ ColumnDef *cols_get(ColumnRegistry *reg, int col_idx) {
 void cols_destroy(ColumnRegistry *reg) {
   if (!reg)
     return;
+  for (int i = 0; i < reg->count; i++)
+    cols_release(&reg->columns[i]);
   free(reg->columns);
   free(reg);
 }
 
 /* --- Predefined columns --- */
 
-static char *render_path_cell(void *user_data, void *row_data) {
+#ifdef SIZE_HUMAN_READABLE
+static const bool size_human = true;
+#else
+static const bool size_human = false;
+#endif
+
+/* Fields of COL_PATH_FIELDS for template_expand() */
+static const char *path_field(void *ctx, char field, char *scratch, size_t cap,
+                              size_t *len) {
+  FileEntry *entry = (FileEntry *)ctx;
+  const char *value;
+
+  switch (field) {
+  case 'n':
+    value = fs_entry_display_name(entry, scratch, cap);
+    break;
+  case 'f':
+    *len = fs_entry_full_path(entry, scratch, cap);
+    return scratch;
+  case 'F':
+    value = fs_entry_resolved_path(entry, scratch, cap);
+    break;
+  case 'd':
+    *len = fs_entry_dir_path(entry, scratch, cap);
+    return scratch;
+  case 'r':
+    value = fs_entry_root_path(entry);
+    break;
+  case 'P':
+    value = entry->dir ? fs_entry_root_path(entry) : ".";
+    break;
+  default:
+    return NULL;
+  }
+
+  if (!value)
+    return NULL;
+  *len = strlen(value);
+  return value;
+}
+
+static size_t format_path_cell(void *user_data, void *row_data, char *buf,
+                               size_t cap) {
   const ColumnDef *col = (const ColumnDef *)user_data;
-  const FileEntry *entry = (const FileEntry *)row_data;
+  FileEntry *entry = (FileEntry *)row_data;
 
+  if (cap == 0)
+    return 0;
+  buf[0] = '\0';
   if (!entry)
-    return strdup("");
-
-  char buf[PATH_MAX * 2] = {0};
-
-  const char *tmpl = col->cell_template ? col->cell_template : "%n";
-  const char *src = tmpl;
-  char *dst = buf;
-  size_t remain = sizeof buf - 1;
-
-  while (*src && remain > 1) {
-    if (*src == '%' && src[1]) {
-      src++;
-      const char *replace = NULL;
-
-      switch (*src) {
-      case '%':
-        replace = "%";
-        break;
-      case 'n':
-        replace = entry->name;
-        break;
-      case 'f':
-        replace = entry->full_path;
-        break;
-      case 'F':
-        replace =
-            entry->resolved_path ? entry->resolved_path : entry->full_path;
-        break;
-      case 'd':
-        replace = entry->dir_path;
-        break;
-      case 'r':
-        replace = entry->root_path;
-        break;
-      case 'P':
-        replace = entry->root_path ? entry->root_path : ".";
-        break;
-      default:
-        if (remain >= 2) {
-          *dst++ = '%';
-          *dst++ = *src;
-          remain -= 2;
-        }
-        break;
-      }
-
-      if (replace) {
-        size_t len = strlen(replace);
-        if (len > remain)
-          len = remain;
-        memcpy(dst, replace, len);
-        dst += len;
-        remain -= len;
-      }
-      src++;
-    } else {
-      *dst++ = *src++;
-      remain--;
-    }
-  }
-  *dst = '\0';
+    return 0;
 
-  return strdup(buf);
+  return template_expand(col->cell_tpl, buf, cap, path_field, entry);
 }
 
-static char *render_size_cell(void *user_data, void *row_data) {
+static size_t format_size_cell(void *user_data, void *row_data, char *buf,
+                               size_t cap) {
   (void)user_data;
-  const FileEntry *entry = (const FileEntry *)row_data;
+  FileEntry *entry = (FileEntry *)row_data;
 
+  if (cap == 0)
+    return 0;
+  buf[0] = '\0';
   if (!entry)
-    return strdup("");
+    return 0;
+
+  fs_entry_ensure_stat(entry);
+  char text[CELL_FORMAT_SIZE_MAX];
+  size_t len = cell_format_size((long long)entry->size, size_human, text);
+  if (len >= cap)
+    len = cap - 1;
+  memcpy(buf, text, len);
+  buf[len] = '\0';
+  return len;
+}
+
+/* Bulk form of format_size_cell */
+static int format_size_column(void *user_data, void *const *rows, int count,
+                              char *text, size_t cap, size_t *offsets) {
+  (void)user_data;
+  long long sizes[COLUMN_BULK_ROWS];
 
-  char buf[64];
-  snprintf(buf, sizeof buf, "%lld", (long long)entry->st.st_size);
-  return strdup(buf);
+  count = SDL_min(count, COLUMN_BULK_ROWS);
+  for (int i = 0; i < count; i++) {
+    FileEntry *entry = (FileEntry *)rows[i];
+    fs_entry_ensure_stat(entry);
+    sizes[i] = (long long)entry->size;
+  }
+  return cell_format_sizes(sizes, count, size_human, text, cap, offsets);
 }
 
-static char *render_date_cell(void *user_data, void *row_data) {
+static size_t format_date_cell(void *user_data, void *row_data, char *buf,
+                               size_t cap) {
   const ColumnDef *col = (const ColumnDef *)user_data;
-  const FileEntry *entry = (const FileEntry *)row_data;
+  FileEntry *entry = (FileEntry *)row_data;
 
+  if (cap == 0)
+    return 0;
+  buf[0] = '\0';
   if (!entry)
-    return strdup("");
+    return 0;
 
-  char buf[128];
-  struct tm tm_buf;
-  const char *fmt = col->cell_template && col->cell_template[0]
-                        ? col->cell_template
-                        : DATE_FORMAT_TEMPLATE;
+  fs_entry_ensure_stat(entry);
+  return date_format(col->date_fmt, entry->mtime, buf, cap);
+}
 
-  if (localtime_r(&entry->st.st_mtime, &tm_buf)) {
-    strftime(buf, sizeof buf, fmt, &tm_buf);
-  } else {
-    strcpy(buf, "???");
-  }
+/* Bulk form of format_date_cell */
+static int format_date_column(void *user_data, void *const *rows, int count,
+                              char *text, size_t cap, size_t *offsets) {
+  const ColumnDef *col = (const ColumnDef *)user_data;
+  time_t times[COLUMN_BULK_ROWS];
 
-  return strdup(buf);
+  count = SDL_min(count, COLUMN_BULK_ROWS);
+  for (int i = 0; i < count; i++) {
+    FileEntry *entry = (FileEntry *)rows[i];
+    fs_entry_ensure_stat(entry);
+    times[i] = entry->mtime;
+  }
+  return date_format_times(col->date_fmt, times, count, text, cap, offsets);
 }
 
-static char *render_perms_cell(void *user_data, void *row_data) {
-  (void)user_data;
-  const FileEntry *entry = (const FileEntry *)row_data;
+static size_t format_perms_cell(void *user_data, void *row_data, char *buf,
+                                size_t cap) {
+  const ColumnDef *col = (const ColumnDef *)user_data;
+  FileEntry *entry = (FileEntry *)row_data;
 
+  if (cap == 0)
+    return 0;
+  buf[0] = '\0';
   if (!entry)
-    return strdup("");
-
-  mode_t m = entry->st.st_mode;
-  char buf[64];
-  snprintf(buf, sizeof buf, "%c%c%c%c%c%c%c%c%c%c",
-           S_ISDIR(m)   ? 'd'
-           : S_ISLNK(m) ? 'l'
-           : S_ISREG(m) ? '-'
-                        : '?',
-           (m & S_IRUSR) ? 'r' : '-', (m & S_IWUSR) ? 'w' : '-',
-           (m & S_IXUSR) ? 'x' : '-', (m & S_IRGRP) ? 'r' : '-',
-           (m & S_IWGRP) ? 'w' : '-', (m & S_IXGRP) ? 'x' : '-',
-           (m & S_IROTH) ? 'r' : '-', (m & S_IWOTH) ? 'w' : '-',
-           (m & S_IXOTH) ? 'x' : '-');
-  return strdup(buf);
+    return 0;
+
+  fs_entry_ensure_stat(entry);
+  return cell_format_mode(entry->mode, col->cell_tpl, buf, cap);
+}
+
+/* Bulk form of format_perms_cell */
+static int format_perms_column(void *user_data, void *const *rows, int count,
+                               char *text, size_t cap, size_t *offsets) {
+  const ColumnDef *col = (const ColumnDef *)user_data;
+  mode_t modes[COLUMN_BULK_ROWS];
+
+  count = SDL_min(count, COLUMN_BULK_ROWS);
+  for (int i = 0; i < count; i++) {
+    FileEntry *entry = (FileEntry *)rows[i];
+    fs_entry_ensure_stat(entry);
+    modes[i] = entry->mode;
+  }
+  return cell_format_modes(modes, count, col->cell_tpl, text, cap, offsets);
 }
 
 ColumnDef col_path_default(void) {
@@ -240,8 +320,9 @@ ColumnDef col_path_default(void) {
       .width_min = 50,
       .width_max = 500,
       .user_data = NULL,
-      .render_cell = render_path_cell,
+      .render_cell = NULL,
       .render_header = NULL,
+      .format_cell = format_path_cell,
   };
 }
 
@@ -253,8 +334,10 @@ ColumnDef col_size_default(void) {
       .width_min = 40,
       .width_max = 150,
       .user_data = NULL,
-      .render_cell = render_size_cell,
+      .render_cell = NULL,
       .render_header = NULL,
+      .format_cell = format_size_cell,
+      .format_column = format_size_column,
   };
 }
 
@@ -266,8 +349,10 @@ ColumnDef col_date_default(void) {
       .width_min = 60,
       .width_max = 300,
       .user_data = NULL,
-      .render_cell = render_date_cell,
+      .render_cell = NULL,
       .render_header = NULL,
+      .format_cell = format_date_cell,
+      .format_column = format_date_column,
   };
 }
 
@@ -279,7 +364,9 @@ ColumnDef col_perms_default(void) {
       .width_min = 60,
       .width_max = 200,
       .user_data = NULL,
-      .render_cell = render_perms_cell,
+      .render_cell = NULL,
       .render_header = NULL,
+      .format_cell = format_perms_cell,
+      .format_column = format_perms_column,
   };
 }
\ No newline at end of file
@@ -0,0 +1,254 @@
+/* src/date_format.c */
+#include "include/date_format.h"
+#include "include/config.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest memoized day text, and most time fields a format may have */
+#define DATE_DAY_MAX 128
+#define DATE_MAX_SLOTS 8
+
+/* Specifiers that only depend on the calendar day (and the UTC offset,
+ * which the memo guards) */
+#define DATE_DAY_SPECS "aAbBCdDeFgGhjmnuUVwWxyYzZt%"
+
+typedef enum { PART_DAY, PART_HOUR, PART_MIN, PART_SEC } PartKind;
+
+typedef struct {
+  PartKind kind;
+  const char *fmt; /* PART_DAY: strftime format of this part */
+} DatePart;
+
+typedef struct {
+  time_t start; /* local midnight; the day is [start, start + 86400) */
+  bool valid;
+  unsigned short len;
+  unsigned short slots[DATE_MAX_SLOTS]; /* where each time field goes */
+  char text[DATE_DAY_MAX];
+} DateDay;
+
+struct DateFormat {
+  char *fmt;        /* whole format for strftime() */
+  bool memo;        /* false: the format is not split, always strftime() */
+  char *part_text;  /* formats of the PART_DAY parts */
+  DatePart *parts;
+  int part_count;
+  PartKind slot_kind[DATE_MAX_SLOTS];
+  int slot_count;
+  long gmtoff; /* UTC offset seen last, to find the memo slot of a day */
+  DateDay days[DATE_FORMAT_CACHE_DAYS];
+};
+
+/* End the day part being written at *out, if any */
+static void split_close(DateFormat *df, char **out, char **part) {
+  if (*out == *part)
+    return;
+  *(*out)++ = '\0';
+  df->parts[df->part_count++] = (DatePart){PART_DAY, *part};
+  *part = *out;
+}
+
+/* Split the format into day parts and time fields. False if it has
+ * anything that depends on the time of day other than two-digit %H, %M
+ * and %S */
+static bool date_format_split(DateFormat *df) {
+  char *out = df->part_text;
+  char *part = out;
+
+  for (const char *s = df->fmt; *s; s++) {
+    if (*s != '%') {
+      *out++ = *s;
+      continue;
+    }
+    char c = *++s;
+    if (c != '\0' && strchr(DATE_DAY_SPECS, c)) {
+      *out++ = '%';
+      *out++ = c;
+      continue;
+    }
+
+    const char *fields = c == 'H'   ? "H"
+                         : c == 'M' ? "M"
+                         : c == 'S' ? "S"
+                         : c == 'T' ? "H:M:S"
+                         : c == 'R' ? "H:M"
+                                    : NULL;
+    if (!fields)
+      return false; /* flags, %E/%O, %c, %I, %p, %s, ... */
+
+    for (; *fields; fields++) {
+      if (*fields == ':') {
+        *out++ = ':';
+        continue;
+      }
+      if (df->slot_count == DATE_MAX_SLOTS)
+        return false;
+      split_close(df, &out, &part);
+      PartKind kind = *fields == 'H'   ? PART_HOUR
+                      : *fields == 'M' ? PART_MIN
+                                       : PART_SEC;
+      df->parts[df->part_count++] = (DatePart){kind, NULL};
+      df->slot_kind[df->slot_count++] = kind;
+    }
+  }
+  split_close(df, &out, &part);
+  return true;
+}
+
+DateFormat *date_format_create(const char *fmt) {
+  if (!fmt)
+    return NULL;
+
+  DateFormat *df = calloc(1, sizeof *df);
+  if (!df)
+    return NULL;
+
+  size_t len = strlen(fmt);
+  df->fmt = strdup(fmt);
+  /* %T, two characters, is the most parts (five) and part text (":" twice
+   * with terminators) a piece of the format turns into */
+  df->part_text = malloc(2 * len + 1);
+  df->parts = malloc((3 * len + 1) * sizeof *df->parts);
+  if (!df->fmt || !df->part_text || !df->parts) {
+    date_format_free(df);
+    return NULL;
+  }
+
+  tzset(); /* once, instead of on every conversion */
+  df->memo = date_format_split(df);
+  return df;
+}
+
+void date_format_free(DateFormat *df) {
+  if (!df)
+    return;
+  free(df->fmt);
+  free(df->part_text);
+  free(df->parts);
+  free(df);
+}
+
+static long long floor_div(long long a, long long b) {
+  long long q = a / b;
+  return q - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+static DateDay *date_day_slot(DateFormat *df, time_t t) {
+  long long day = floor_div((long long)t + df->gmtoff, 86400);
+  long long n = DATE_FORMAT_CACHE_DAYS;
+  return &df->days[((day % n) + n) % n];
+}
+
+/* Day text with "00" where the time fields go */
+static bool date_day_build(const DateFormat *df, DateDay *day,
+                           const struct tm *tm) {
+  size_t len = 0;
+  int slot = 0;
+
+  for (int i = 0; i < df->part_count; i++) {
+    const DatePart *part = &df->parts[i];
+    if (part->kind == PART_DAY) {
+      size_t n = strftime(day->text + len, DATE_DAY_MAX - len, part->fmt, tm);
+      if (n == 0)
+        return false; /* too long, or empty and ambiguous */
+      len += n;
+    } else {
+      if (len + 2 >= DATE_DAY_MAX)
+        return false;
+      day->slots[slot++] = (unsigned short)len;
+      day->text[len++] = '0';
+      day->text[len++] = '0';
+    }
+  }
+  day->text[len] = '\0';
+  day->len = (unsigned short)len;
+  return true;
+}
+
+/* Memoized day of t, NULL if t has to go through strftime() */
+static const DateDay *date_day(DateFormat *df, time_t t) {
+  DateDay *day = date_day_slot(df, t);
+  if (day->valid && t >= day->start && t - day->start < 86400)
+    return day;
+
+  struct tm tm;
+  if (!localtime_r(&t, &tm))
+    return NULL;
+  df->gmtoff = tm.tm_gmtoff;
+
+  /* DST guard: the day is memoized only if it is exactly 86400 seconds
+   * of one UTC offset */
+  time_t start = t - (tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec);
+  time_t end = start + 86399;
+  struct tm first, last;
+  if (!localtime_r(&start, &first) || !localtime_r(&end, &last) ||
+      first.tm_gmtoff != tm.tm_gmtoff || last.tm_gmtoff != tm.tm_gmtoff ||
+      first.tm_hour != 0 || first.tm_min != 0 || first.tm_sec != 0 ||
+      last.tm_hour != 23 || last.tm_min != 59 || last.tm_sec != 59 ||
+      last.tm_yday != tm.tm_yday)
+    return NULL;
+
+  day = date_day_slot(df, t);
+  day->valid = date_day_build(df, day, &tm);
+  day->start = start;
+  return day->valid ? day : NULL;
+}
+
+size_t date_format(DateFormat *df, time_t t, char *buf, size_t cap) {
+  if (!buf || cap == 0)
+    return 0;
+  buf[0] = '\0';
+  if (!df)
+    return 0;
+
+  const DateDay *day = df->memo ? date_day(df, t) : NULL;
+  if (day) {
+    if (day->len >= cap)
+      return 0; /* as strftime() */
+    memcpy(buf, day->text, day->len + 1);
+
+    int sod = (int)(t - day->start);
+    int values[] = {sod / 3600, sod / 60 % 60, sod % 60};
+    for (int i = 0; i < df->slot_count; i++) {
+      int v = values[df->slot_kind[i] - PART_HOUR];
+      char *p = buf + day->slots[i];
+      p[0] = (char)('0' + v / 10);
+      p[1] = (char)('0' + v % 10);
+    }
+    return day->len;
+  }
+
+  struct tm tm;
+  if (!localtime_r(&t, &tm)) {
+    int n = snprintf(buf, cap, "???");
+    return n < 0 ? 0 : (size_t)n < cap ? (size_t)n : cap - 1;
+  }
+  size_t len = strftime(buf, cap, df->fmt, &tm);
+  buf[len] = '\0'; /* contents are unspecified when it does not fit */
+  return len;
+}
+
+int date_format_times(DateFormat *df, const time_t *times, int count,
+                      char *text, size_t cap, size_t *offsets) {
+  size_t used = 0;
+  int i = 0;
+  for (; i < count && used < cap; i++) {
+    size_t avail = cap - used;
+    size_t len;
+    if (avail >= TABLE_CELL_MAX) {
+      len = date_format(df, times[i], text + used, TABLE_CELL_MAX);
+    } else {
+      /* "" from strftime() cannot tell a cut cell from an empty one */
+      char cell[TABLE_CELL_MAX];
+      len = date_format(df, times[i], cell, sizeof cell);
+      if (len >= avail)
+        break;
+      memcpy(text + used, cell, len + 1);
+    }
+    offsets[i] = used;
+    used += len + 1;
+  }
+  return i;
+}
@@ -1,35 +1,32 @@
 #include "include/events.h"
 #include "include/config.h"
 #include "include/globals.h"
+#include "include/layout.h"
 #include "include/scroll.h"
 #include "include/table_model.h"
 #include <SDL3/SDL_events.h>
-#include <math.h>
 
-static void ensure_cell_visible_and_scroll(int row, int col) {
-  if (!g_col_left || !g_col_widths)
+static void ensure_cell_visible_and_scroll(int64_t row, int col) {
+  if (col < 0 || col >= g_layout.col_count)
     return;
 
-  int total_rows = g_table ? table_get_row_count(g_table) + 1 : g_rows;
+  int64_t total_rows = g_table ? table_get_row_count(g_table) + 1 : g_rows;
   if (row >= total_rows)
     return;
 
-  float cell_x = g_col_left[col];
-  float cell_w = (float)g_col_widths[col];
-  float line_w = GRID_LINE_WIDTH;
-  float cell_h = g_row_height;
-  float row_full = cell_h + line_w;
+  double cell_x = g_layout.col_left[col];
+  double cell_w = (double)g_layout.col_widths[col];
 
-  float cell_y = row * row_full;
-  float cell_h_full = cell_h;
+  double cell_y = layout_row_top(&g_layout, row);
+  double cell_h_full = layout_row_height(&g_layout, row);
 
-  float left = g_offset_x;
-  float right = g_offset_x + g_content_w;
-  float top = g_offset_y;
-  float bottom = g_offset_y + g_content_h;
+  double left = g_offset_x;
+  double right = g_offset_x + g_content_w;
+  double top = g_offset_y;
+  double bottom = g_offset_y + g_content_h;
 
-  float desired_target_x = g_scroll_target_x;
-  float desired_target_y = g_scroll_target_y;
+  double desired_target_x = g_scroll_target_x;
+  double desired_target_y = g_scroll_target_y;
 
   if (cell_w > g_content_w) {
     desired_target_x = cell_x;
@@ -47,14 +44,14 @@ static void ensure_cell_visible_and_scroll(int row, int col) {
     desired_target_y = cell_y + cell_h_full - g_content_h;
   }
 
-  float max_target_x = SDL_max(0.0f, g_total_grid_w - g_content_w);
-  float max_target_y = SDL_max(0.0f, g_total_grid_h - g_content_h);
+  double max_target_x = SDL_max(0.0, g_total_grid_w - g_content_w);
+  double max_target_y = SDL_max(0.0, g_total_grid_h - g_content_h);
 
-  desired_target_x = SDL_clamp(desired_target_x, 0.0f, max_target_x);
-  desired_target_y = SDL_clamp(desired_target_y, 0.0f, max_target_y);
+  desired_target_x = SDL_clamp(desired_target_x, 0.0, max_target_x);
+  desired_target_y = SDL_clamp(desired_target_y, 0.0, max_target_y);
 
-  float dx = desired_target_x - g_scroll_target_x;
-  float dy = desired_target_y - g_scroll_target_y;
+  double dx = desired_target_x - g_scroll_target_x;
+  double dy = desired_target_y - g_scroll_target_y;
 
 #ifdef SMOOTH_SCROLL
   scroll_add_target(dx, dy);
@@ -64,9 +61,9 @@ static void ensure_cell_visible_and_scroll(int row, int col) {
 }
 
 static void move_selection_by(int drow, int dcol) {
-  int total_rows = g_table ? table_get_row_count(g_table) + 1 : g_rows;
+  int64_t total_rows = g_table ? table_get_row_count(g_table) + 1 : g_rows;
 
-  int new_r = g_selected_row;
+  int64_t new_r = g_selected_row;
   int new_c = g_selected_col;
 
   int min_row = ALLOW_HEADER_SELECTION ? 0 : 1;
@@ -163,12 +160,14 @@ bool handle_events(SDL_Event *event, int win_w_local, int win_h_local) {
         float vert_bar_x = view_x_local + content_w_local;
         float vert_bar_y = view_y_local;
         float vert_bar_h = content_h_local;
-        float thumb_h = SDL_max(10.0f, content_h_local *
-                                           (content_h_local / g_total_grid_h));
-        float denom = SDL_max(0.0f, g_total_grid_h - content_h_local);
-        float thumb_y = denom <= 0.0f ? vert_bar_y
-                                      : vert_bar_y + (g_offset_y / denom) *
-                                                         (vert_bar_h - thumb_h);
+        float thumb_h = SDL_max(
+            10.0f,
+            (float)(content_h_local * (content_h_local / g_total_grid_h)));
+        double denom = SDL_max(0.0, g_total_grid_h - content_h_local);
+        float thumb_y =
+            denom <= 0.0 ? vert_bar_y
+                         : vert_bar_y + (float)(g_offset_y / denom) *
+                                            (vert_bar_h - thumb_h);
 
         if (mx >= (int)vert_bar_x && mx < (int)(vert_bar_x + SCROLLBAR_WIDTH) &&
             my >= (int)vert_bar_y && my < (int)(vert_bar_y + vert_bar_h)) {
@@ -186,9 +185,9 @@ bool handle_events(SDL_Event *event, int win_w_local, int win_h_local) {
             float desired_thumb_center =
                 SDL_clamp(click_pos, thumb_center_min, thumb_center_max);
             float desired_thumb_top = desired_thumb_center - thumb_h / 2.0f;
-            if (track_h > 0.0f && denom > 0.0f) {
-              float new_offset = (desired_thumb_top / track_h) * denom;
-              new_offset = SDL_clamp(new_offset, 0.0f, denom);
+            if (track_h > 0.0f && denom > 0.0) {
+              double new_offset = (desired_thumb_top / track_h) * denom;
+              new_offset = SDL_clamp(new_offset, 0.0, denom);
               g_offset_y = new_offset;
               g_scroll_target_y = new_offset;
               scroll_clamp_all();
@@ -202,12 +201,14 @@ bool handle_events(SDL_Event *event, int win_w_local, int win_h_local) {
         float horz_bar_x = view_x_local;
         float horz_bar_y = view_y_local + content_h_local;
         float horz_bar_w = content_w_local;
-        float thumb_w = SDL_max(10.0f, content_w_local *
-                                           (content_w_local / g_total_grid_w));
-        float denom = SDL_max(0.0f, g_total_grid_w - content_w_local);
-        float thumb_x = denom <= 0.0f ? horz_bar_x
-                                      : horz_bar_x + (g_offset_x / denom) *
-                                                         (horz_bar_w - thumb_w);
+        float thumb_w = SDL_max(
+            10.0f,
+            (float)(content_w_local * (content_w_local / g_total_grid_w)));
+        double denom = SDL_max(0.0, g_total_grid_w - content_w_local);
+        float thumb_x =
+            denom <= 0.0 ? horz_bar_x
+                         : horz_bar_x + (float)(g_offset_x / denom) *
+                                            (horz_bar_w - thumb_w);
 
         if (mx >= (int)horz_bar_x && mx < (int)(horz_bar_x + horz_bar_w) &&
             my >= (int)horz_bar_y && my < (int)(horz_bar_y + SCROLLBAR_WIDTH)) {
@@ -225,9 +226,9 @@ bool handle_events(SDL_Event *event, int win_w_local, int win_h_local) {
             float desired_thumb_center =
                 SDL_clamp(click_pos, thumb_center_min, thumb_center_max);
             float desired_thumb_left = desired_thumb_center - thumb_w / 2.0f;
-            if (track_w > 0.0f && denom > 0.0f) {
-              float new_offset = (desired_thumb_left / track_w) * denom;
-              new_offset = SDL_clamp(new_offset, 0.0f, denom);
+            if (track_w > 0.0f && denom > 0.0) {
+              double new_offset = (desired_thumb_left / track_w) * denom;
+              new_offset = SDL_clamp(new_offset, 0.0, denom);
               g_offset_x = new_offset;
               g_scroll_target_x = new_offset;
               scroll_clamp_all();
@@ -245,29 +246,24 @@ bool handle_events(SDL_Event *event, int win_w_local, int win_h_local) {
         return quit;
       }
 
-      float virtual_x = (float)(mx - view_x_local) + g_offset_x;
-      float virtual_y = (float)(my - view_y_local) + g_offset_y;
+      double virtual_x = (double)(mx - view_x_local) + g_offset_x;
+      double virtual_y = (double)(my - view_y_local) + g_offset_y;
 
-      float line_w = GRID_LINE_WIDTH;
-      float cell_h = g_row_height;
-      float row_full = cell_h + line_w;
-
-      if (virtual_y < 0.0f) {
+      if (virtual_y < 0.0) {
         g_selected_row = g_selected_col = g_selected_index = -1;
         return quit;
       }
 
-      int row = (int)(virtual_y / row_full);
-      float in_row_y = fmodf(virtual_y, row_full);
-      if (in_row_y < 0.0f)
-        in_row_y += row_full;
+      double in_row_y;
+      int64_t row = layout_row_at(&g_layout, virtual_y, &in_row_y);
 
-      if (in_row_y >= cell_h) {
+      /* On the grid line below the row */
+      if (in_row_y >= layout_row_height(&g_layout, row)) {
         g_selected_row = g_selected_col = g_selected_index = -1;
         return quit;
       }
 
-      int total_rows = g_table ? table_get_row_count(g_table) + 1 : g_rows;
+      int64_t total_rows = g_table ? table_get_row_count(g_table) + 1 : g_rows;
 
       if (row < 0 || row >= total_rows) {
         g_selected_row = g_selected_col = g_selected_index = -1;
@@ -279,28 +275,18 @@ bool handle_events(SDL_Event *event, int win_w_local, int win_h_local) {
         return quit;
       }
 
-      if (!g_col_left || !g_col_widths) {
+      if (g_layout.col_count == 0) {
         g_selected_row = g_selected_col = g_selected_index = -1;
         return quit;
       }
 
-      int found_col = -1;
-      for (int c = 0; c < g_cols; c++) {
-        float col_l = g_col_left[c];
-        float col_w = (float)g_col_widths[c];
-        if (virtual_x >= col_l && virtual_x < col_l + col_w) {
-          found_col = c;
-          break;
-        }
-        if (c < g_cols - 1) {
-          float sep_start = col_l + col_w;
-          float sep_end = sep_start + line_w;
-          if (virtual_x >= sep_start && virtual_x < sep_end) {
-            found_col = -1;
-            break;
-          }
-        }
-      }
+      /* The column by binary search; a click on the grid line right of it
+       * or past the last column selects nothing */
+      int found_col = layout_col_at(&g_layout, virtual_x);
+      if (virtual_x < g_layout.col_left[found_col] ||
+          virtual_x >= g_layout.col_left[found_col] +
+                            (double)g_layout.col_widths[found_col])
+        found_col = -1;
 
       if (found_col >= 0) {
         g_selected_row = row;
@@ -316,23 +302,23 @@ bool handle_events(SDL_Event *event, int win_w_local, int win_h_local) {
   case SDL_EVENT_MOUSE_MOTION:
     if (g_dragging_vert) {
       float content_h_local = g_content_h;
-      float thumb_h =
-          SDL_max(10.0f, content_h_local * (content_h_local / g_total_grid_h));
-      float max_offset_y = SDL_max(0.0f, g_total_grid_h - content_h_local);
+      float thumb_h = SDL_max(
+          10.0f, (float)(content_h_local * (content_h_local / g_total_grid_h)));
+      double max_offset_y = SDL_max(0.0, g_total_grid_h - content_h_local);
       float track_h = content_h_local - thumb_h;
       float dy = (float)event->motion.y - g_drag_start_pos;
-      float scroll_factor = (track_h > 0.0f) ? (max_offset_y / track_h) : 0.0f;
+      double scroll_factor = (track_h > 0.0f) ? (max_offset_y / track_h) : 0.0;
       g_offset_y = g_drag_start_offset + dy * scroll_factor;
       g_scroll_target_y = g_offset_y;
       scroll_clamp_all();
     } else if (g_dragging_horz) {
       float content_w_local = g_content_w;
-      float thumb_w =
-          SDL_max(10.0f, content_w_local * (content_w_local / g_total_grid_w));
-      float max_offset_x = SDL_max(0.0f, g_total_grid_w - content_w_local);
+      float thumb_w = SDL_max(
+          10.0f, (float)(content_w_local * (content_w_local / g_total_grid_w)));
+      double max_offset_x = SDL_max(0.0, g_total_grid_w - content_w_local);
       float track_w = content_w_local - thumb_w;
       float dx = (float)event->motion.x - g_drag_start_pos;
-      float scroll_factor = (track_w > 0.0f) ? (max_offset_x / track_w) : 0.0f;
+      double scroll_factor = (track_w > 0.0f) ? (max_offset_x / track_w) : 0.0;
       g_offset_x = g_drag_start_offset + dx * scroll_factor;
       g_scroll_target_x = g_offset_x;
       scroll_clamp_all();
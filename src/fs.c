@@ -1,288 +1,798 @@
 #include "include/fs.h"
+#include "include/arena.h"
+#include "include/cell_format.h"
 #include "include/config.h"
 #include "include/fileentry.h"
 #include "include/globals.h"
+#include "include/statx_ring.h"
 #include "include/table_model.h"
 #include <SDL3/SDL.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
-/* --- File batch info --- */
+/* Record layout returned by getdents64(2) */
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+/* --- File batch info ---
+ * Workers publish full batches onto a lock-free stack; the UI thread takes
+ * the whole stack at once in fs_drain(), so neither side ever waits. */
+typedef struct FsBatch {
+  struct FsBatch *next;
+  int count;
+  FileEntry *entries[BATCH_SIZE];
+} FsBatch;
+
+/* Published batches, newest first */
+static void *fs_ready = NULL;
+
+/* --- Directory node: work item for a directory still to be listed ---
+ * The directory stays open while subdirectories queued from it still need it
+ * as the base for openat(); every queued child holds a reference. */
+typedef struct FsDir {
+  struct FsDir *parent;
+  const DirNode *node; /* interned, outlives the traversal */
+  size_t path_len;      /* length of the full path, for the PATH_MAX check */
+  int depth;
+  int fd;
+  SDL_AtomicInt refs;
+} FsDir;
+
+/* Per-worker deque. The owner pushes and pops at the bottom (depth-first,
+ * cache friendly), thieves take from the top where the shallowest and
+ * therefore usually largest subtrees are. */
 typedef struct {
-  FileEntry *entry;
-} FileBatch;
+  FsDir **items;
+  int head;
+  int count;
+  int capacity;
+  SDL_SpinLock lock;
+} FsDeque;
+
+typedef struct {
+  int id;
+  FsDeque deque;
+  FsBatch *batch;
+  Arena *arena; /* the table provider's arena for this worker's entries */
+  char *dents; /* FS_GETDENTS_BUFFER_SIZE bytes */
+
+  /* Entries of the current getdents chunk, stat()ed together */
+  StatxRing *ring;
+  const char *names[FS_URING_DEPTH];
+  unsigned char types[FS_URING_DEPTH];
+  struct stat stats[FS_URING_DEPTH];
+  int stat_res[FS_URING_DEPTH];
+} FsWorker;
+
+static FsWorker *fs_workers = NULL;
+static int fs_worker_count = 0;
+
+/* Directories queued or being listed right now; 0 means traversal is done */
+static SDL_AtomicInt fs_pending;
+
+/* Running totals, one shard per worker on its own cache line: each worker
+ * only adds to its own shard and readers sum them, so no lock is taken */
+typedef struct {
+  alignas(64) atomic_ullong bytes;
+  atomic_ullong file_bytes;
+  atomic_ullong disk_bytes;
+} FsTotalsShard;
+
+static FsTotalsShard fs_totals[FS_MAX_WORKERS];
 
-static FileBatch batch[BATCH_SIZE];
-static int batch_count = 0;
+/* Whether entries are stat()ed while listing or only when first rendered */
+static bool fs_eager_stat = true;
 
 /* Static storage for original and canonical path used in header substitution */
 static char *fs_orig_path = NULL;
 static char *fs_canon_path = NULL;
 
-/* Helper: dynamic append to buffer */
-static bool buf_append(char **bufp, size_t *cap, size_t *len, const char *src) {
-  if (!src)
-    return true;
-  size_t need = strlen(src);
-  if (*len + need + 1 > *cap) {
-    size_t newcap = (*cap == 0) ? 128 : (*cap * 2);
-    while (newcap < *len + need + 1)
-      newcap *= 2;
-    char *n = realloc(*bufp, newcap);
-    if (!n)
-      return false;
-    *bufp = n;
-    *cap = newcap;
-  }
-  memcpy((*bufp) + *len, src, need);
-  *len += need;
-  (*bufp)[*len] = '\0';
-  return true;
+FsTotals fs_get_totals(void) {
+  FsTotals totals = {0};
+  for (int i = 0; i < FS_MAX_WORKERS; i++) {
+    totals.bytes +=
+        atomic_load_explicit(&fs_totals[i].bytes, memory_order_relaxed);
+    totals.file_bytes +=
+        atomic_load_explicit(&fs_totals[i].file_bytes, memory_order_relaxed);
+    totals.disk_bytes +=
+        atomic_load_explicit(&fs_totals[i].disk_bytes, memory_order_relaxed);
+  }
+  return totals;
 }
 
-/* Public function: Render a header template with substitutions. */
-char *render_header_template(const char *tmpl) {
-  if (!tmpl)
-    return strdup("");
-  char *out = NULL;
-  size_t cap = 0, len = 0;
-
-  for (size_t i = 0; tmpl[i] != '\0'; ++i) {
-    if (tmpl[i] == '%' && tmpl[i + 1] != '\0') {
-      char t = tmpl[++i];
-      if (t == '%') {
-        if (!buf_append(&out, &cap, &len, "%"))
-          goto fail;
-      } else if (t == 'P') {
-        if (!buf_append(&out, &cap, &len, fs_canon_path ? fs_canon_path : ""))
-          goto fail;
-      } else if (t == 'p') {
-        if (!buf_append(&out, &cap, &len, fs_orig_path ? fs_orig_path : ""))
-          goto fail;
-      } else if (t == 'b') {
-        char numbuf[64];
-        snprintf(numbuf, sizeof numbuf, "%llu",
-                 (unsigned long long)g_total_bytes);
-        if (!buf_append(&out, &cap, &len, numbuf))
-          goto fail;
-      } else if (t == 'f') {
-        char numbuf[64];
-        snprintf(numbuf, sizeof numbuf, "%llu",
-                 (unsigned long long)g_total_file_bytes);
-        if (!buf_append(&out, &cap, &len, numbuf))
-          goto fail;
-      } else if (t == 'd') {
-        char numbuf[64];
-        snprintf(numbuf, sizeof numbuf, "%llu",
-                 (unsigned long long)g_total_disk_bytes);
-        if (!buf_append(&out, &cap, &len, numbuf))
-          goto fail;
-      } else {
-        /* unknown escape: output '%' and the char */
-        char tmp[3] = {'%', t, '\0'};
-        if (!buf_append(&out, &cap, &len, tmp))
-          goto fail;
-      }
+/* Fields of FS_HEADER_FIELDS for template_expand(); ctx is FsTotals */
+static const char *header_field(void *ctx, char field, char *scratch,
+                                size_t cap, size_t *len) {
+  const FsTotals *totals = (const FsTotals *)ctx;
+  const char *value;
+
+  switch (field) {
+  case 'P':
+    value = fs_canon_path ? fs_canon_path : "";
+    break;
+  case 'p':
+    value = fs_orig_path ? fs_orig_path : "";
+    break;
+  case 'b':
+  case 'f':
+  case 'd': {
+    unsigned long long number = field == 'b'   ? totals->bytes
+                                : field == 'f' ? totals->file_bytes
+                                               : totals->disk_bytes;
+    *len = cell_format_u64(number, scratch);
+    return scratch;
+  }
+  default:
+    return NULL;
+  }
+
+  *len = strlen(value);
+  return value;
+}
+
+size_t fs_format_header(const Template *tpl, char *buf, size_t cap) {
+  FsTotals totals = fs_get_totals();
+  return template_expand(tpl, buf, cap, header_field, &totals);
+}
+/* --- Work-stealing deque --- */
+static bool deque_push(FsDeque *dq, FsDir *work) {
+  SDL_LockSpinlock(&dq->lock);
+
+  if (dq->head + dq->count == dq->capacity) {
+    if (dq->head > 0) {
+      /* Reuse the space left behind by thieves */
+      memmove(dq->items, dq->items + dq->head,
+              (size_t)dq->count * sizeof *dq->items);
+      dq->head = 0;
     } else {
-      char tmp[2] = {tmpl[i], '\0'};
-      if (!buf_append(&out, &cap, &len, tmp))
-        goto fail;
+      int new_cap = dq->capacity == 0 ? 64 : dq->capacity * 2;
+      FsDir **new_items =
+          realloc(dq->items, (size_t)new_cap * sizeof *new_items);
+      if (!new_items) {
+        SDL_UnlockSpinlock(&dq->lock);
+        return false;
+      }
+      dq->items = new_items;
+      dq->capacity = new_cap;
     }
   }
 
-  return out;
+  dq->items[dq->head + dq->count] = work;
+  dq->count++;
 
-fail:
-  free(out);
-  return NULL;
+  SDL_UnlockSpinlock(&dq->lock);
+  return true;
 }
 
-/* --- flush/add batch as before --- */
-static void flush_batch(void) {
-  if (batch_count == 0)
-    return;
+static bool deque_pop(FsDeque *dq, FsDir **out) {
+  bool found = false;
 
-  if (g_stop)
-    return;
+  SDL_LockSpinlock(&dq->lock);
+  if (dq->count > 0) {
+    dq->count--;
+    *out = dq->items[dq->head + dq->count];
+    if (dq->count == 0)
+      dq->head = 0;
+    found = true;
+  }
+  SDL_UnlockSpinlock(&dq->lock);
 
-  SDL_LockMutex(g_grid_mutex);
+  return found;
+}
 
-  /* Get filesystem provider context and insert rows */
-  for (int i = 0; i < batch_count; i++) {
-    if (!table_insert_row(g_table, table_get_row_count(g_table),
-                          batch[i].entry)) {
-      fprintf(stderr, "Failed to insert row into table\n");
-    }
+static bool deque_steal(FsDeque *dq, FsDir **out) {
+  bool found = false;
+
+  if (!SDL_TryLockSpinlock(&dq->lock))
+    return false;
+  if (dq->count > 0) {
+    *out = dq->items[dq->head];
+    dq->head++;
+    dq->count--;
+    if (dq->count == 0)
+      dq->head = 0;
+    found = true;
   }
+  SDL_UnlockSpinlock(&dq->lock);
+
+  return found;
+}
 
-  if (g_vscroll) {
-    g_vscroll->total_virtual_rows = table_get_row_count(g_table) + 1;
-    g_vscroll->needs_reload = true;
+/* Drop a reference; the last one closes the directory */
+static void fs_dir_release(FsDir *d) {
+  while (d && SDL_AddAtomicInt(&d->refs, -1) == 1) {
+    FsDir *parent = d->parent; /* still set if d was never opened */
+    if (d->fd >= 0)
+      close(d->fd);
+    free(d);
+    d = parent;
   }
+}
 
-  SDL_UnlockMutex(g_grid_mutex);
+/* --- Path building from interned directories --- */
+static size_t dir_path_append(const DirNode *d, char *buf, size_t cap) {
+  size_t len = 0;
+  if (d->parent) {
+    len = dir_path_append(d->parent, buf, cap);
+    if (len + 1 >= cap)
+      return cap;
+    buf[len++] = '/';
+  }
+  if (len + d->name_len >= cap)
+    return cap;
+  memcpy(buf + len, d->name, d->name_len);
+  return len + d->name_len;
+}
 
-  batch_count = 0;
+/* Same as dir_path_append but relative to the traversal root */
+static size_t dir_relative_append(const DirNode *d, char *buf, size_t cap) {
+  if (!d->parent)
+    return 0;
+  size_t len = dir_relative_append(d->parent, buf, cap);
+  if (len > 0) {
+    if (len + 1 >= cap)
+      return cap;
+    buf[len++] = '/';
+  }
+  if (len + d->name_len >= cap)
+    return cap;
+  memcpy(buf + len, d->name, d->name_len);
+  return len + d->name_len;
 }
 
-/* add_file: creates FileEntry and adds to batch */
-static void add_file(const char *display_name, const char *full_path,
-                     const char *dir_path, const char *root_path,
-                     struct stat *st, bool is_broken_symlink) {
-  if (batch_count == BATCH_SIZE) {
-    flush_batch();
+/* Terminate a built path, or empty it if it did not fit */
+static size_t path_finish(char *buf, size_t len, size_t cap) {
+  if (len >= cap) {
+    buf[0] = '\0';
+    return 0;
   }
+  buf[len] = '\0';
+  return len;
+}
 
-  FileEntry *entry = calloc(1, sizeof *entry);
+/* Append "/<name>" to a built path */
+static size_t path_append_name(char *buf, size_t len, size_t cap,
+                               const char *name) {
+  size_t name_len = strlen(name);
+  if (len + 1 + name_len >= cap)
+    return cap;
+  buf[len++] = '/';
+  memcpy(buf + len, name, name_len);
+  return len + name_len;
+}
+
+size_t fs_entry_dir_path(const FileEntry *entry, char *buf, size_t cap) {
+  if (!buf || cap == 0)
+    return 0;
+  if (!entry || !entry->dir)
+    return path_finish(buf, cap, cap);
+  return path_finish(buf, dir_path_append(entry->dir, buf, cap), cap);
+}
+
+size_t fs_entry_full_path(const FileEntry *entry, char *buf, size_t cap) {
+  if (!buf || cap == 0)
+    return 0;
+  if (!entry || !entry->dir)
+    return path_finish(buf, cap, cap);
+  size_t len = dir_path_append(entry->dir, buf, cap);
+  if (len < cap)
+    len = path_append_name(buf, len, cap, entry->name);
+  return path_finish(buf, len, cap);
+}
+
+const char *fs_entry_root_path(const FileEntry *entry) {
+  if (!entry || !entry->dir)
+    return "";
+  const DirNode *d = entry->dir;
+  while (d->parent)
+    d = d->parent;
+  return d->name;
+}
+
+const char *fs_entry_display_name(const FileEntry *entry, char *buf,
+                                  size_t cap) {
   if (!entry)
+    return "";
+#ifdef SHOW_FILE_RELATIVE_PATH
+  if (buf && cap > 0 && entry->dir && entry->dir->parent) {
+    size_t len = dir_relative_append(entry->dir, buf, cap);
+    if (len < cap)
+      len = path_append_name(buf, len, cap, entry->name);
+    if (path_finish(buf, len, cap) > 0)
+      return buf;
+  }
+#else
+  (void)dir_relative_append;
+  (void)buf;
+  (void)cap;
+#endif
+  return entry->name;
+}
+
+/* Error messages are the only place traversal needs a full path */
+static void report_path(const char *fmt, const DirNode *dir, const char *name,
+                        int err) {
+  char path[PATH_MAX];
+  size_t len = dir_path_append(dir, path, sizeof path);
+  if (name && len < sizeof path)
+    len = path_append_name(path, len, sizeof path, name);
+  path_finish(path, len, sizeof path);
+  fprintf(stderr, fmt, path, strerror(err));
+}
+
+/* Queue a subdirectory on the worker's own deque */
+static void fs_push_dir(FsWorker *w, FsDir *parent, const DirNode *node,
+                        size_t path_len, int depth) {
+  FsDir *d = calloc(1, sizeof *d);
+  if (!d)
     return;
 
-  entry->name = strdup(display_name ? display_name : "");
-  entry->full_path = strdup(full_path ? full_path : "");
-  entry->dir_path = strdup(dir_path ? dir_path : "");
-  entry->root_path = strdup(root_path ? root_path : "");
+  d->node = node;
+  d->path_len = path_len;
+  d->depth = depth;
+  d->fd = -1;
+  SDL_SetAtomicInt(&d->refs, 1);
 
-  if (st) {
-    entry->st = *st;
+  if (parent) {
+    SDL_AddAtomicInt(&parent->refs, 1);
+    d->parent = parent;
   }
 
-  entry->is_regular_file = S_ISREG(st->st_mode);
-  entry->is_broken_symlink = is_broken_symlink;
+  SDL_AddAtomicInt(&fs_pending, 1);
+  if (!deque_push(&w->deque, d)) {
+    report_path("Failed to queue directory '%s': %s\n", node, NULL, ENOMEM);
+    SDL_AddAtomicInt(&fs_pending, -1);
+    fs_dir_release(d);
+  }
+}
+
+/* Take work from the other workers, starting with the next one */
+static bool fs_steal_work(FsWorker *w, FsDir **out) {
+  for (int i = 1; i < fs_worker_count; i++) {
+    FsWorker *victim = &fs_workers[(w->id + i) % fs_worker_count];
+    if (deque_steal(&victim->deque, out))
+      return true;
+  }
+  return false;
+}
+
+/* --- flush/add batch --- */
+static void flush_batch(FsWorker *w) {
+  FsBatch *b = w->batch;
+  if (!b || b->count == 0)
+    return;
+
+  w->batch = NULL;
+
+  void *head;
+  do {
+    head = SDL_GetAtomicPointer(&fs_ready);
+    b->next = (FsBatch *)head;
+  } while (!SDL_CompareAndSwapAtomicPointer(&fs_ready, head, b));
+}
+
+int fs_drain(TableModel *table) {
+  FsBatch *list = (FsBatch *)SDL_SetAtomicPointer(&fs_ready, NULL);
 
-  char resolved[PATH_MAX];
-  if (realpath(full_path, resolved)) {
-    entry->resolved_path = strdup(resolved);
+  /* Restore publication order */
+  FsBatch *fifo = NULL;
+  while (list) {
+    FsBatch *next = list->next;
+    list->next = fifo;
+    fifo = list;
+    list = next;
   }
 
-  batch[batch_count].entry = entry;
-  batch_count++;
+  int added = 0;
+  while (fifo) {
+    FsBatch *next = fifo->next;
+    if (table_append_rows(table, (void **)fifo->entries, fifo->count)) {
+      added += fifo->count;
+    } else {
+      fprintf(stderr, "Failed to insert rows into table\n");
+    }
+    free(fifo);
+    fifo = next;
+  }
+
+  return added;
+}
+
+/* add_file: creates FileEntry and adds to the worker's batch */
+static FileEntry *add_file(FsWorker *w, const DirNode *dir, const char *name,
+                           const struct stat *st, bool has_stat,
+                           bool is_broken_symlink) {
+  if (w->batch && w->batch->count == BATCH_SIZE) {
+    flush_batch(w);
+  }
+  if (!w->batch) {
+    w->batch = calloc(1, sizeof *w->batch);
+    if (!w->batch)
+      return NULL;
+  }
+
+  FileEntry *entry = arena_alloc(w->arena, sizeof *entry, alignof(FileEntry));
+  if (!entry)
+    return NULL;
+  *entry = (FileEntry){0};
+
+  entry->name = arena_strndup(w->arena, name, strlen(name));
+  if (!entry->name)
+    return NULL;
+  entry->dir = dir;
+
+  entry->size = st->st_size;
+  entry->mtime = st->st_mtime;
+  entry->mode = st->st_mode;
+
+  entry->has_stat = has_stat;
+  entry->is_regular_file = S_ISREG(st->st_mode);
+  entry->is_broken_symlink = is_broken_symlink;
+
+  w->batch->entries[w->batch->count++] = entry;
 
   /* Update totals */
-  if (st->st_size > 0) {
-    SDL_LockMutex(g_grid_mutex);
-    g_total_bytes += (unsigned long long)st->st_size;
+  if (has_stat && st->st_size > 0) {
+    FsTotalsShard *shard = &fs_totals[w->id];
+    atomic_fetch_add_explicit(&shard->bytes, (unsigned long long)st->st_size,
+                              memory_order_relaxed);
     if (S_ISREG(st->st_mode)) {
-      g_total_file_bytes += (unsigned long long)st->st_size;
+      atomic_fetch_add_explicit(&shard->file_bytes,
+                                (unsigned long long)st->st_size,
+                                memory_order_relaxed);
     }
-    g_total_disk_bytes += (unsigned long long)st->st_blocks * 512;
-    SDL_UnlockMutex(g_grid_mutex);
+    atomic_fetch_add_explicit(&shard->disk_bytes,
+                              (unsigned long long)st->st_blocks * 512,
+                              memory_order_relaxed);
   }
+
+  return entry;
 }
 
-static void traverse_recursive(const char *dir_path, const char *prefix,
-                               int depth) {
-  if (g_stop)
-    return;
+/* Intern a subdirectory; its name is shared with the entry listing it */
+static const DirNode *intern_dir(FsWorker *w, const DirNode *parent,
+                                 const char *name) {
+  DirNode *node = arena_alloc(w->arena, sizeof *node, alignof(DirNode));
+  if (!node)
+    return NULL;
+  node->parent = parent;
+  node->name = name;
+  node->name_len = (unsigned short)strlen(name);
+  return node;
+}
+
+/* Open a queued directory relative to its parent's descriptor, so the kernel
+ * only resolves one path component */
+static bool fs_dir_open(FsDir *d) {
+  if (d->parent) {
+    d->fd = openat(d->parent->fd, d->node->name,
+                   O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    fs_dir_release(d->parent);
+    d->parent = NULL;
+  } else {
+    d->fd = open(d->node->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+
+  return d->fd != -1;
+}
+
+/* File type bits for a d_type value, 0 when the filesystem did not say */
+static mode_t dtype_to_mode(unsigned char d_type) {
+  switch (d_type) {
+  case DT_REG:
+    return S_IFREG;
+  case DT_DIR:
+    return S_IFDIR;
+  case DT_LNK:
+    return S_IFLNK;
+  case DT_CHR:
+    return S_IFCHR;
+  case DT_BLK:
+    return S_IFBLK;
+  case DT_FIFO:
+    return S_IFIFO;
+  case DT_SOCK:
+    return S_IFSOCK;
+  default:
+    return 0;
+  }
+}
 
-  DIR *dir = opendir(dir_path);
-  if (!dir) {
-    fprintf(stderr, "Failed to open directory '%s': %s\n", dir_path,
-            strerror(errno));
+/* lstat is needed while listing if the type is unknown or stat data will be
+ * shown; symlinks are examined separately */
+static bool fs_entry_needs_stat(mode_t type) {
+  return type == 0 || (fs_eager_stat && !S_ISLNK(type));
+}
+
+/* Handles one directory entry returned by getdents64. `pre` is its lstat
+ * result when that was already fetched in a batch. */
+static void traverse_entry(FsWorker *w, FsDir *d, const char *name,
+                           unsigned char d_type, const struct stat *pre) {
+  /* Полный путь не собираем, но его длину проверяем как раньше */
+  size_t path_len = d->path_len + 1 + strlen(name);
+  if (path_len + 1 > PATH_MAX) {
+    report_path("Path too long: '%s': %s\n", d->node, name, ENAMETOOLONG);
     return;
   }
 
-  struct dirent *entry;
-  while ((entry = readdir(dir))) {
-    if (g_stop) {
-      closedir(dir);
+  /* Тип берём из d_type; stat нужен только если его данные кто-то покажет
+   * или файловая система тип не сообщила */
+  struct stat st = {0};
+  st.st_mode = dtype_to_mode(d_type);
+  bool has_stat = false;
+
+  if (pre) {
+    st = *pre;
+    has_stat = true;
+  } else if (fs_entry_needs_stat(st.st_mode)) {
+    /* Информация о самом файле (не target), относительно открытого каталога */
+    if (fstatat(d->fd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+      report_path("lstat failed for '%s': %s\n", d->node, name, errno);
       return;
     }
+    has_stat = true;
+  }
 
-    /* Пропускаем . и .. */
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-      continue;
+  /* Определяем тип файла */
+  bool is_symlink = S_ISLNK(st.st_mode);
+  bool is_dir = S_ISDIR(st.st_mode);
+  bool should_recurse = false;
+  FileEntry *entry;
 
-    /* Составляем полный путь */
-    char full_path[PATH_MAX];
-    snprintf(full_path, sizeof full_path, "%s/%s", dir_path, entry->d_name);
+  if (is_symlink) {
+    /* Это симлинк */
+    if (SYMLINK_BEHAVIOUR == SYMLINK_IGNORE) {
+      /* Полностью игнорируем */
+      return;
+    }
 
-    /* Составляем display_name */
-    char display_name[PATH_MAX];
-#ifdef SHOW_FILE_RELATIVE_PATH
-    if (prefix && prefix[0] != '\0') {
-      snprintf(display_name, sizeof display_name, "%s/%s", prefix,
-               entry->d_name);
+    /* Проверяем target для определения типа */
+    struct stat target_st;
+    bool target_exists = (fstatat(d->fd, name, &target_st, 0) == 0);
+
+    if (!target_exists) {
+      /* Broken symlink */
+      char full_path[PATH_MAX];
+      size_t len = dir_path_append(d->node, full_path, sizeof full_path);
+      len = path_append_name(full_path, len, sizeof full_path, name);
+      path_finish(full_path, len, sizeof full_path);
+      fprintf(stderr, "Broken symlink: '%s'\n", full_path);
+      if (!has_stat && fstatat(d->fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+        has_stat = true;
+      entry = add_file(w, d->node, name, &st, has_stat, true);
     } else {
-      snprintf(display_name, sizeof display_name, "%s", entry->d_name);
+      /* Symlink указывает на существующий файл */
+      entry = add_file(w, d->node, name, &target_st, true, false);
+
+      if (SYMLINK_BEHAVIOUR == SYMLINK_LIST_RECURSE &&
+          S_ISDIR(target_st.st_mode) && d->depth < SYMLINK_RECURSE_MAX_DEPTH) {
+        should_recurse = true;
+      }
     }
-#else
-    snprintf(display_name, sizeof display_name, "%s", entry->d_name);
-#endif
+  } else if (is_dir) {
+    /* Это обычный каталог */
+    entry = add_file(w, d->node, name, &st, has_stat, false);
+    should_recurse = true;
+  } else {
+    /* Это обычный файл */
+    entry = add_file(w, d->node, name, &st, has_stat, false);
+  }
 
-    /* Используем lstat для информации о самом файле (не target) */
-    struct stat st;
-    if (lstat(full_path, &st) == -1) {
-      fprintf(stderr, "lstat failed for '%s': %s\n", full_path,
-              strerror(errno));
-      continue;
+  if (should_recurse && entry) {
+    /* Имя каталога общее с его строкой в таблице */
+    const DirNode *node = intern_dir(w, d->node, entry->name);
+    if (node)
+      fs_push_dir(w, d, node, path_len, d->depth + 1);
+  }
+}
+
+/* Stat the collected chunk in one io_uring submission, then handle it */
+static void traverse_chunk(FsWorker *w, FsDir *d, int count) {
+  int batched = 0;
+  const char *batch_names[FS_URING_DEPTH];
+  int batch_idx[FS_URING_DEPTH];
+
+  if (w->ring) {
+    for (int i = 0; i < count; i++) {
+      if (fs_entry_needs_stat(dtype_to_mode(w->types[i]))) {
+        batch_idx[batched] = i;
+        batch_names[batched] = w->names[i];
+        batched++;
+      }
     }
+  }
 
-    /* Определяем тип файла и размер */
-    bool is_symlink = S_ISLNK(st.st_mode);
-    bool is_dir = S_ISDIR(st.st_mode);
-    bool should_add = false;
-    bool should_recurse = false;
+  bool have_stats = false;
+  if (batched > 0) {
+    have_stats = statx_ring_stat(w->ring, d->fd, batch_names, batched,
+                                 AT_SYMLINK_NOFOLLOW, w->stats, w->stat_res);
+    if (!have_stats) {
+      fprintf(stderr, "io_uring statx failed, using fstatat\n");
+      statx_ring_destroy(w->ring);
+      w->ring = NULL;
+    }
+  }
 
-    if (is_symlink) {
-      /* Это симлинк */
-      if (SYMLINK_BEHAVIOUR == SYMLINK_IGNORE) {
-        /* Полностью игнорируем */
+  int next = 0;
+  for (int i = 0; i < count && !g_stop; i++) {
+    const struct stat *pre = NULL;
+    if (have_stats && next < batched && batch_idx[next] == i) {
+      /* On error fall through to fstatat, which reports it */
+      if (w->stat_res[next] == 0)
+        pre = &w->stats[next];
+      next++;
+    }
+    traverse_entry(w, d, w->names[i], w->types[i], pre);
+  }
+}
+
+/* Lists one directory in bulk with getdents64; subdirectories are queued
+ * instead of recursed into */
+static void traverse_dir(FsWorker *w, FsDir *d) {
+  if (g_stop)
+    return;
+
+  if (!fs_dir_open(d)) {
+    report_path("Failed to open directory '%s': %s\n", d->node, NULL, errno);
+    return;
+  }
+
+  for (;;) {
+    long nread =
+        syscall(SYS_getdents64, d->fd, w->dents, FS_GETDENTS_BUFFER_SIZE);
+    if (nread == 0)
+      break;
+    if (nread == -1) {
+      report_path("Failed to read directory '%s': %s\n", d->node, NULL,
+                  errno);
+      break;
+    }
+
+    int count = 0;
+    for (long pos = 0; pos < nread;) {
+      struct linux_dirent64 *de = (struct linux_dirent64 *)(w->dents + pos);
+      pos += de->d_reclen;
+
+      /* Пропускаем . и .. */
+      const char *name = de->d_name;
+      if (name[0] == '.' &&
+          (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
         continue;
+
+      w->names[count] = name;
+      w->types[count] = de->d_type;
+      if (++count == FS_URING_DEPTH) {
+        traverse_chunk(w, d, count);
+        count = 0;
       }
+    }
+    traverse_chunk(w, d, count);
+
+    if (g_stop)
+      return;
+  }
+}
+
+/* Stat data is needed during traversal when a column shows it or a header
+ * template sums sizes */
+static bool fs_need_eager_stat(void) {
+  if (!g_table)
+    return true;
 
-      /* Проверяем target для определения типа */
+  int cols = table_get_col_count(g_table);
+  for (int c = 0; c < cols; c++) {
+    ColumnDef *col = table_get_column(g_table, c);
+    if (!col)
+      continue;
+    if (col->type != COL_PATH)
+      return true;
+    if (template_uses(col->header_tpl, 'b') ||
+        template_uses(col->header_tpl, 'f') ||
+        template_uses(col->header_tpl, 'd'))
+      return true;
+  }
+  return false;
+}
+
+/* Loads stat data deferred by traversal, following symlinks the same way */
+void fs_entry_ensure_stat(FileEntry *entry) {
+  if (!entry || entry->has_stat)
+    return;
+
+  char full_path[PATH_MAX];
+  struct stat st;
+  if (fs_entry_full_path(entry, full_path, sizeof full_path) > 0 &&
+      lstat(full_path, &st) == 0) {
+    if (S_ISLNK(st.st_mode) && !entry->is_broken_symlink) {
       struct stat target_st;
-      bool target_exists = (stat(full_path, &target_st) == 0);
-
-      if (!target_exists) {
-        /* Broken symlink */
-        fprintf(stderr, "Broken symlink: '%s'\n", full_path);
-        should_add = true;
-        add_file(display_name, full_path, dir_path,
-                 fs_orig_path ? fs_orig_path : dir_path, &st, true);
-      } else {
-        /* Symlink указывает на существующий файл */
-        should_add = true;
-        add_file(display_name, full_path, dir_path,
-                 fs_orig_path ? fs_orig_path : dir_path, &target_st, false);
-
-        if (SYMLINK_BEHAVIOUR == SYMLINK_LIST_RECURSE &&
-            S_ISDIR(target_st.st_mode) && depth < SYMLINK_RECURSE_MAX_DEPTH) {
-          should_recurse = true;
-        }
-      }
-    } else if (is_dir) {
-      /* Это обычный каталог */
-      should_add = true;
-      add_file(display_name, full_path, dir_path,
-               fs_orig_path ? fs_orig_path : dir_path, &st, false);
-      should_recurse = true;
-    } else {
-      /* Это обычный файл */
-      should_add = true;
-      add_file(display_name, full_path, dir_path,
-               fs_orig_path ? fs_orig_path : dir_path, &st, false);
+      if (stat(full_path, &target_st) == 0)
+        st = target_st;
     }
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->mode = st.st_mode;
+    entry->is_regular_file = S_ISREG(st.st_mode);
+  }
+  entry->has_stat = true;
+}
+
+/* Canonical path of an entry, resolved on first request and cached; rows that
+ * are never rendered with %F never pay for realpath(). Falls back to the full
+ * path, built into buf */
+const char *fs_entry_resolved_path(FileEntry *entry, char *buf, size_t cap) {
+  if (!entry)
+    return NULL;
+
+  if (!entry->resolved_checked) {
+    char full_path[PATH_MAX];
+    char resolved[PATH_MAX];
+    Arena *arena =
+        provider_fs_render_arena(g_table ? g_table->provider : NULL);
+    if (arena && fs_entry_full_path(entry, full_path, sizeof full_path) > 0 &&
+        realpath(full_path, resolved))
+      entry->resolved_path = arena_strndup(arena, resolved, strlen(resolved));
+    entry->resolved_checked = true;
+  }
+  if (entry->resolved_path)
+    return entry->resolved_path;
+
+  fs_entry_full_path(entry, buf, cap);
+  return buf;
+}
 
-    if (should_recurse) {
-      traverse_recursive(full_path, display_name, depth + 1);
+static int fs_worker_main(void *arg) {
+  FsWorker *w = (FsWorker *)arg;
+  FsDir *work;
+
+  while (!g_stop) {
+    if (deque_pop(&w->deque, &work) || fs_steal_work(w, &work)) {
+      traverse_dir(w, work);
+      fs_dir_release(work);
+      SDL_AddAtomicInt(&fs_pending, -1);
+      continue;
     }
+
+    /* Nothing queued anywhere and nobody is listing a directory that could
+     * still produce more work */
+    if (SDL_GetAtomicInt(&fs_pending) == 0)
+      break;
+
+    SDL_DelayNS(FS_IDLE_SLEEP_NS);
   }
 
-  closedir(dir);
+  flush_batch(w);
+  free(w->batch); /* only left if it was empty */
+  w->batch = NULL;
+  return 0;
+}
+
+static int fs_worker_count_config(void) {
+  int count = FS_WORKER_THREADS;
+  if (count <= 0)
+    count = SDL_GetNumLogicalCPUCores();
+  return SDL_clamp(count, 1, FS_MAX_WORKERS);
 }
 
 int traverse_fs(void *arg) {
   char *dir_path = (char *)arg;
-  batch_count = 0;
 
   /* Save original path */
   if (fs_orig_path) {
@@ -303,19 +813,100 @@ int traverse_fs(void *arg) {
   }
 
   /* Reset total bytes for this traversal */
-  SDL_LockMutex(g_grid_mutex);
-  g_total_bytes = 0ULL;
-  g_total_file_bytes = 0ULL;
-  g_total_disk_bytes = 0ULL;
-  SDL_UnlockMutex(g_grid_mutex);
+  for (int i = 0; i < FS_MAX_WORKERS; i++) {
+    atomic_store_explicit(&fs_totals[i].bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&fs_totals[i].file_bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&fs_totals[i].disk_bytes, 0, memory_order_relaxed);
+  }
 
-  traverse_recursive(dir_path, "", 0);
-  flush_batch();
+  /* Entries belong to the table's provider and are allocated from its
+   * arenas */
+  DataProvider *provider = g_table ? g_table->provider : NULL;
+  if (!provider_fs_arena(provider, 0)) {
+    fprintf(stderr, "Traversal needs a filesystem provider\n");
+    free(dir_path);
+    g_fs_traversing = false;
+    return 0;
+  }
+
+  fs_worker_count = fs_worker_count_config();
+  fs_workers = calloc((size_t)fs_worker_count, sizeof *fs_workers);
+  if (!fs_workers) {
+    fprintf(stderr, "Failed to allocate traversal workers\n");
+    fs_worker_count = 0;
+  }
+  for (int i = 0; i < fs_worker_count; i++) {
+    fs_workers[i].id = i;
+    fs_workers[i].arena = provider_fs_arena(provider, i);
+    fs_workers[i].dents = malloc(FS_GETDENTS_BUFFER_SIZE);
+    if (!fs_workers[i].dents) {
+      fprintf(stderr, "Failed to allocate directory buffer\n");
+      fs_worker_count = i;
+      break;
+    }
+#ifdef FS_WITH_IO_URING
+    fs_workers[i].ring = statx_ring_create(FS_URING_DEPTH);
+#endif
+  }
+#ifdef FS_WITH_IO_URING
+  if (fs_worker_count > 0 && !fs_workers[0].ring) {
+    fprintf(stderr, "io_uring unavailable, using fstatat\n");
+  }
+#endif
+  fs_eager_stat = fs_need_eager_stat();
+
+  if (fs_worker_count > 0) {
+    SDL_SetAtomicInt(&fs_pending, 0);
+    /* Корень хранит путь как его передали */
+    size_t root_len = strlen(dir_path);
+    DirNode *root = NULL;
+    if (root_len < PATH_MAX)
+      root = arena_alloc(fs_workers[0].arena, sizeof *root, alignof(DirNode));
+    if (root) {
+      root->parent = NULL;
+      root->name = arena_strndup(fs_workers[0].arena, dir_path, root_len);
+      root->name_len = (unsigned short)root_len;
+    }
+    if (root && root->name)
+      fs_push_dir(&fs_workers[0], NULL, root, root_len, 0);
+    else
+      fprintf(stderr, "Failed to start traversal of '%s'\n", dir_path);
+
+    /* This thread is worker 0, the rest get their own threads */
+    SDL_Thread *threads[FS_MAX_WORKERS] = {0};
+    for (int i = 1; i < fs_worker_count; i++) {
+      threads[i] =
+          SDL_CreateThread(fs_worker_main, "FS Worker", &fs_workers[i]);
+      if (!threads[i]) {
+        fprintf(stderr, "Failed to create traversal worker: %s\n",
+                SDL_GetError());
+      }
+    }
+
+    fs_worker_main(&fs_workers[0]);
+
+    for (int i = 1; i < fs_worker_count; i++) {
+      if (threads[i])
+        SDL_WaitThread(threads[i], NULL);
+    }
+
+    /* Drop whatever was left queued after a stop request */
+    for (int i = 0; i < fs_worker_count; i++) {
+      FsDir *work;
+      while (deque_pop(&fs_workers[i].deque, &work)) {
+        fs_dir_release(work);
+      }
+      free(fs_workers[i].deque.items);
+    }
+  }
 
-  if (g_vscroll) {
-    g_vscroll->total_virtual_rows = table_get_row_count(g_table) + 1;
-    g_vscroll->needs_reload = true;
+  for (int i = 0; i < fs_worker_count; i++) {
+    free(fs_workers[i].dents);
+    statx_ring_destroy(fs_workers[i].ring);
   }
+  free(fs_workers);
+  fs_workers = NULL;
+  fs_worker_count = 0;
 
   free(dir_path);
 
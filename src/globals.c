@@ -1,4 +1,6 @@
 #include "include/globals.h"
+#include "include/grid.h"
+#include "include/layout.h"
 #include "include/table_model.h"
 #include "include/types.h"
 #include "include/utils.h"
@@ -11,6 +13,8 @@
 SDL_Renderer *g_renderer = NULL;
 SDL_Window *g_window = NULL;
 TTF_Font *g_font = NULL;
+GlyphAtlas *g_atlas = NULL;
+TextMeasure *g_measure = NULL;
 
 /* NEW: Table model */
 TableModel *g_table = NULL;
@@ -20,19 +24,19 @@ Cell **g_grid = NULL;
 int g_rows = 0;
 int g_cols = 0;
 
-float g_offset_x = 0.0f;
-float g_offset_y = 0.0f;
+double g_offset_x = 0.0;
+double g_offset_y = 0.0;
 
 bool g_dragging_vert = false;
 bool g_dragging_horz = false;
 float g_drag_start_pos = 0.0f;
-float g_drag_start_offset = 0.0f;
+double g_drag_start_offset = 0.0;
 
 bool g_need_horz = false;
 bool g_need_vert = false;
 
-float g_total_grid_w = 0.0f;
-float g_total_grid_h = 0.0f;
+double g_total_grid_w = 0.0;
+double g_total_grid_h = 0.0;
 float g_content_w = 0.0f;
 float g_content_h = 0.0f;
 float g_view_x = 0.0f;
@@ -42,36 +46,23 @@ float g_view_h = 0.0f;
 
 FILE *g_log_file = NULL;
 
-float g_scroll_target_x = 0.0f;
-float g_scroll_target_y = 0.0f;
+double g_scroll_target_x = 0.0;
+double g_scroll_target_y = 0.0;
 
 SDL_Mutex *g_grid_mutex = NULL;
 
-int *g_max_col_widths = NULL;
-
 bool g_fs_traversing = false;
 
 volatile bool g_stop = false;
 
-int g_selected_row = -1;
+int64_t g_selected_row = -1;
 int g_selected_col = -1;
-int g_selected_index = -1;
+int64_t g_selected_index = -1;
 
 float g_row_height = 0.0f;
-float *g_col_left = NULL;
-int *g_col_widths = NULL;
+SizeAlloc g_layout = {0};
 
 VirtualScrollState *g_vscroll = NULL;
-float g_last_content_h = 0.0f;
-
-/* Суммарный размер всех найденных файлов (обновляется при обходе FS) */
-unsigned long long g_total_bytes = 0ULL;
-
-/* Суммарный размер только обычных файлов (без директорий) */
-unsigned long long g_total_file_bytes = 0ULL;
-
-/* Реальный размер на диске (блоки, с учётом фрагментации и метаданных) */
-unsigned long long g_total_disk_bytes = 0ULL;
 
 void cleanup(void) {
   if (g_table) {
@@ -89,20 +80,8 @@ void cleanup(void) {
     g_grid_mutex = NULL;
   }
 
-  if (g_max_col_widths) {
-    free(g_max_col_widths);
-    g_max_col_widths = NULL;
-  }
-
-  if (g_col_left) {
-    free(g_col_left);
-    g_col_left = NULL;
-  }
-
-  if (g_col_widths) {
-    free(g_col_widths);
-    g_col_widths = NULL;
-  }
+  layout_free(&g_layout);
+  grid_free();
 
   if (g_grid) {
     for (int r = 0; r < g_rows; r++) {
@@ -119,6 +98,16 @@ void cleanup(void) {
     g_grid = NULL;
   }
 
+  if (g_atlas) {
+    glyph_atlas_destroy(g_atlas);
+    g_atlas = NULL;
+  }
+
+  if (g_measure) {
+    text_measure_destroy(g_measure);
+    g_measure = NULL;
+  }
+
   if (g_font) {
     TTF_CloseFont(g_font);
     g_font = NULL;
@@ -0,0 +1,260 @@
+/* src/glyph_atlas.c */
+#include "include/glyph_atlas.h"
+#include "include/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  Uint32 ch;
+  bool used;
+  bool ready; /* false if the font cannot render it */
+  SDL_FRect src; /* in atlas pixels */
+  float advance;
+} Glyph;
+
+struct GlyphAtlas {
+  SDL_Renderer *renderer;
+  TTF_Font *font;
+  SDL_Color fg, bg;
+  SDL_Texture *texture;
+  int line_height;
+
+  /* Shelf packing: glyphs are placed left to right on rows as tall as
+   * the font */
+  int pen_x, pen_y;
+
+  /* Open addressing by code point */
+  Glyph glyphs[GLYPH_ATLAS_MAX_GLYPHS];
+  int glyph_count;
+
+  /* Queued quads, kept between frames */
+  SDL_Vertex *vertices;
+  int *indices;
+  int quad_count;
+  int quad_capacity;
+};
+
+GlyphAtlas *glyph_atlas_create(SDL_Renderer *renderer, TTF_Font *font,
+                               SDL_Color fg, SDL_Color bg) {
+  if (!renderer || !font)
+    return NULL;
+
+  GlyphAtlas *atlas = calloc(1, sizeof *atlas);
+  if (!atlas)
+    return NULL;
+
+  atlas->renderer = renderer;
+  atlas->font = font;
+  atlas->fg = fg;
+  atlas->bg = bg;
+  atlas->line_height = TTF_GetFontHeight(font);
+
+  atlas->texture =
+      SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                        SDL_TEXTUREACCESS_STATIC, GLYPH_ATLAS_SIZE,
+                        GLYPH_ATLAS_SIZE);
+  if (!atlas->texture) {
+    fprintf(stderr, "Failed to create glyph atlas: %s\n", SDL_GetError());
+    free(atlas);
+    return NULL;
+  }
+  /* LCD glyphs come with their background, so quads are opaque */
+  SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_NONE);
+  SDL_SetTextureScaleMode(atlas->texture, SDL_SCALEMODE_NEAREST);
+
+  return atlas;
+}
+
+void glyph_atlas_destroy(GlyphAtlas *atlas) {
+  if (!atlas)
+    return;
+  if (atlas->texture)
+    SDL_DestroyTexture(atlas->texture);
+  free(atlas->vertices);
+  free(atlas->indices);
+  free(atlas);
+}
+
+int glyph_atlas_line_height(const GlyphAtlas *atlas) {
+  return atlas ? atlas->line_height : 0;
+}
+
+/* Forget every glyph; the texture is refilled as text asks for them */
+static void atlas_reset(GlyphAtlas *atlas) {
+  glyph_atlas_flush(atlas); /* queued quads still point at old glyphs */
+  memset(atlas->glyphs, 0, sizeof atlas->glyphs);
+  atlas->glyph_count = 0;
+  atlas->pen_x = 0;
+  atlas->pen_y = 0;
+}
+
+/* Rasterise a glyph and upload it into free space of the atlas. Returns
+ * false only when the atlas is full; glyphs the font cannot render are
+ * kept with ready unset so they are not retried */
+static bool atlas_render_glyph(GlyphAtlas *atlas, Glyph *g) {
+  int advance = 0;
+  if (!TTF_GetGlyphMetrics(atlas->font, g->ch, NULL, NULL, NULL, NULL,
+                           &advance))
+    return true;
+  g->advance = (float)advance;
+
+  SDL_Surface *rendered =
+      TTF_RenderGlyph_LCD(atlas->font, g->ch, atlas->fg, atlas->bg);
+  if (!rendered)
+    return true;
+  SDL_Surface *surface =
+      SDL_ConvertSurface(rendered, SDL_PIXELFORMAT_ARGB8888);
+  SDL_DestroySurface(rendered);
+  if (!surface)
+    return true;
+
+  int w = SDL_min(surface->w, GLYPH_ATLAS_SIZE);
+  int h = SDL_min(surface->h, GLYPH_ATLAS_SIZE);
+  if (atlas->pen_x + w > GLYPH_ATLAS_SIZE) {
+    atlas->pen_x = 0;
+    atlas->pen_y += atlas->line_height;
+  }
+  if (atlas->pen_y + h > GLYPH_ATLAS_SIZE) {
+    SDL_DestroySurface(surface);
+    return false;
+  }
+
+  SDL_Rect dst = {atlas->pen_x, atlas->pen_y, w, h};
+  if (SDL_UpdateTexture(atlas->texture, &dst, surface->pixels,
+                        surface->pitch)) {
+    g->src = (SDL_FRect){(float)dst.x, (float)dst.y, (float)w, (float)h};
+    g->ready = true;
+    atlas->pen_x += w;
+  }
+  SDL_DestroySurface(surface);
+  return true;
+}
+
+static Glyph *atlas_find(GlyphAtlas *atlas, Uint32 ch) {
+  unsigned i = (ch * 2654435761u) & (GLYPH_ATLAS_MAX_GLYPHS - 1);
+  while (atlas->glyphs[i].used && atlas->glyphs[i].ch != ch)
+    i = (i + 1) & (GLYPH_ATLAS_MAX_GLYPHS - 1);
+  return &atlas->glyphs[i];
+}
+
+static Glyph *atlas_insert(GlyphAtlas *atlas, Uint32 ch) {
+  Glyph *g = atlas_find(atlas, ch);
+  g->ch = ch;
+  g->used = true;
+  atlas->glyph_count++;
+  return g;
+}
+
+/* Glyph for a code point, rendered into the atlas on first use */
+static const Glyph *atlas_glyph(GlyphAtlas *atlas, Uint32 ch) {
+  Glyph *g = atlas_find(atlas, ch);
+  if (g->used)
+    return g;
+
+  /* Keep the table sparse enough for probing */
+  if (atlas->glyph_count >= GLYPH_ATLAS_MAX_GLYPHS * 3 / 4)
+    atlas_reset(atlas);
+
+  g = atlas_insert(atlas, ch);
+  if (!atlas_render_glyph(atlas, g)) {
+    /* Out of space: start over with only what is drawn from now on */
+    atlas_reset(atlas);
+    g = atlas_insert(atlas, ch);
+    atlas_render_glyph(atlas, g);
+  }
+  return g;
+}
+
+float glyph_atlas_text_width(GlyphAtlas *atlas, const char *text, size_t len) {
+  if (!atlas || !text)
+    return 0.0f;
+
+  float width = 0.0f;
+  Uint32 prev = 0;
+  while (len > 0) {
+    Uint32 ch = SDL_StepUTF8(&text, &len);
+    int kerning = 0;
+    if (prev && TTF_GetGlyphKerning(atlas->font, prev, ch, &kerning))
+      width += (float)kerning;
+    width += atlas_glyph(atlas, ch)->advance;
+    prev = ch;
+  }
+  return width;
+}
+
+static bool atlas_reserve(GlyphAtlas *atlas, int quads) {
+  if (atlas->quad_count + quads <= atlas->quad_capacity)
+    return true;
+
+  int new_cap = atlas->quad_capacity == 0 ? 256 : atlas->quad_capacity;
+  while (new_cap < atlas->quad_count + quads)
+    new_cap *= 2;
+
+  SDL_Vertex *vertices =
+      realloc(atlas->vertices, (size_t)new_cap * 4 * sizeof *vertices);
+  if (!vertices)
+    return false;
+  atlas->vertices = vertices;
+
+  int *indices =
+      realloc(atlas->indices, (size_t)new_cap * 6 * sizeof *indices);
+  if (!indices)
+    return false;
+  atlas->indices = indices;
+
+  atlas->quad_capacity = new_cap;
+  return true;
+}
+
+void glyph_atlas_queue_text(GlyphAtlas *atlas, const char *text, size_t len,
+                            float x, float y) {
+  if (!atlas || !text)
+    return;
+
+  const float texel = 1.0f / GLYPH_ATLAS_SIZE;
+  const SDL_FColor white = {1.0f, 1.0f, 1.0f, 1.0f};
+  Uint32 prev = 0;
+
+  while (len > 0) {
+    Uint32 ch = SDL_StepUTF8(&text, &len);
+    int kerning = 0;
+    if (prev && TTF_GetGlyphKerning(atlas->font, prev, ch, &kerning))
+      x += (float)kerning;
+    prev = ch;
+
+    const Glyph *g = atlas_glyph(atlas, ch);
+    if (g->ready && atlas_reserve(atlas, 1)) {
+      float u0 = g->src.x * texel, v0 = g->src.y * texel;
+      float u1 = (g->src.x + g->src.w) * texel;
+      float v1 = (g->src.y + g->src.h) * texel;
+
+      int base = atlas->quad_count * 4;
+      SDL_Vertex *v = &atlas->vertices[base];
+      v[0] = (SDL_Vertex){{x, y}, white, {u0, v0}};
+      v[1] = (SDL_Vertex){{x + g->src.w, y}, white, {u1, v0}};
+      v[2] = (SDL_Vertex){{x + g->src.w, y + g->src.h}, white, {u1, v1}};
+      v[3] = (SDL_Vertex){{x, y + g->src.h}, white, {u0, v1}};
+
+      int *idx = &atlas->indices[atlas->quad_count * 6];
+      idx[0] = base;
+      idx[1] = base + 1;
+      idx[2] = base + 2;
+      idx[3] = base;
+      idx[4] = base + 2;
+      idx[5] = base + 3;
+      atlas->quad_count++;
+    }
+    x += g->advance;
+  }
+}
+
+void glyph_atlas_flush(GlyphAtlas *atlas) {
+  if (!atlas || atlas->quad_count == 0)
+    return;
+
+  SDL_RenderGeometry(atlas->renderer, atlas->texture, atlas->vertices,
+                     atlas->quad_count * 4, atlas->indices,
+                     atlas->quad_count * 6);
+  atlas->quad_count = 0;
+}
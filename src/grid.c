@@ -2,6 +2,8 @@
 #include "include/grid.h"
 #include "include/config.h"
 #include "include/globals.h"
+#include "include/glyph_atlas.h"
+#include "include/layout.h"
 #include "include/scrollbar.h"
 #include "include/table_model.h"
 #include "include/utils.h"
@@ -10,7 +12,89 @@
 #include <stdlib.h>
 #include <string.h>
 
-void draw_with_alloc(const SizeAlloc *sa) {
+#ifdef WITH_GRID
+/* Grid line rectangles, kept between frames and grown only when more grid
+ * lines show than ever before. Horizontal and vertical lines take turns */
+static SDL_FRect *line_rects = NULL;
+static int line_rects_cap = 0;
+
+static bool reserve_line_rects(int count) {
+  if (count <= line_rects_cap)
+    return true;
+
+  int cap = SDL_max(line_rects_cap * 2, 64);
+  while (cap < count)
+    cap *= 2;
+  SDL_FRect *rects = realloc(line_rects, (size_t)cap * sizeof *rects);
+  if (!rects)
+    return false;
+  line_rects = rects;
+  line_rects_cap = cap;
+  return true;
+}
+#endif
+
+void grid_free(void) {
+#ifdef WITH_GRID
+  free(line_rects);
+  line_rects = NULL;
+  line_rects_cap = 0;
+#endif
+}
+
+/* Queue the text of a cell line by line, at most max_lines of them, placed
+ * in the w x h cell at (x, y) by the configured alignment */
+static void queue_cell_text(Cell *cell, int max_lines, float x, float y,
+                            float w, float h) {
+  const char *text = cell->text;
+  int text_h = glyph_atlas_line_height(g_atlas);
+
+  int lines = 1;
+  for (const char *p = text; lines < max_lines && (p = strchr(p, '\n')); p++)
+    lines++;
+  float block_h = (float)(lines * text_h);
+
+  float padding_y = 0;
+#if TEXT_FONT_POSITION_VERTICAL == TOP
+  padding_y = CELL_PADDING;
+#elif TEXT_FONT_POSITION_VERTICAL == CENTER
+  padding_y = (h - block_h) / 2.0f;
+#elif TEXT_FONT_POSITION_VERTICAL == BOTTOM
+  padding_y = h - block_h - CELL_PADDING;
+#endif
+
+  for (int i = 0; i < lines; i++) {
+    size_t len = strcspn(text, "\n");
+    float padding_x = 0;
+
+#if TEXT_FONT_POSITION_HORIZONTAL == LEFT
+    /* Left-aligned text does not need its width */
+    (void)w;
+    padding_x = CELL_PADDING;
+#else
+    int text_w;
+    if (i == 0 && text[len] == '\0') {
+      /* A cell of one line keeps its width */
+      if (cell->text_width < 0)
+        cell->text_width = (int)glyph_atlas_text_width(g_atlas, text, len);
+      text_w = cell->text_width;
+    } else {
+      text_w = (int)glyph_atlas_text_width(g_atlas, text, len);
+    }
+#if TEXT_FONT_POSITION_HORIZONTAL == CENTER
+    padding_x = (w - text_w) / 2.0f;
+#elif TEXT_FONT_POSITION_HORIZONTAL == RIGHT
+    padding_x = w - text_w - CELL_PADDING;
+#endif
+#endif
+
+    glyph_atlas_queue_text(g_atlas, text, len, x + padding_x,
+                           y + padding_y + (float)(i * text_h));
+    text += len + 1;
+  }
+}
+
+void draw_with_alloc(const SizeAlloc *sa, const FrameSnapshot *snap) {
   int win_w, win_h;
   SDL_GetWindowSize(g_window, &win_w, &win_h);
 
@@ -29,14 +113,20 @@ void draw_with_alloc(const SizeAlloc *sa) {
   float clip_h = sa->content_h + (sa->need_horz ? SCROLLBAR_WIDTH : 0.0f);
 
   float line_w = GRID_LINE_WIDTH;
-  float cell_h = sa->row_height;
-  float row_full = cell_h + line_w;
+  /* Rows are at least one line high */
+  float row_full = sa->row_height + line_w;
+
+  double max_offset_x = SDL_max(0.0, sa->total_grid_w - content_w);
+  double max_offset_y = SDL_max(0.0, sa->total_grid_h - content_h);
 
-  float max_offset_x = SDL_max(0.0f, sa->total_grid_w - content_w);
-  float max_offset_y = SDL_max(0.0f, sa->total_grid_h - content_h);
+  g_offset_x = SDL_clamp(g_offset_x, 0.0, max_offset_x);
+  g_offset_y = SDL_clamp(g_offset_y, 0.0, max_offset_y);
 
-  g_offset_x = SDL_clamp(g_offset_x, 0.0f, max_offset_x);
-  g_offset_y = SDL_clamp(g_offset_y, 0.0f, max_offset_y);
+  /* Virtual coordinates are doubles; only what is relative to the view is
+   * narrowed to float for the renderer */
+  /* Only the visible columns [first_col, col_end) are visited */
+  int first_col = SDL_max(layout_col_at(sa, g_offset_x), 0);
+  int col_end = layout_col_at(sa, g_offset_x + content_w) + 1;
 
 #ifdef WITH_BORDER
   SDL_SetRenderDrawColour(g_renderer, BORDER_COLOUR);
@@ -51,24 +141,26 @@ void draw_with_alloc(const SizeAlloc *sa) {
   SDL_SetRenderClipRect(g_renderer, &clip_rect);
 
 #ifdef WITH_GRID
-  float offset_mod = fmodf(g_offset_y, row_full);
-  if (offset_mod < 0.0f)
-    offset_mod += row_full;
-  float first_row_top_y = view_y - offset_mod;
-  int rows_needed = (int)ceilf((content_h + offset_mod) / row_full) + 1;
-  SDL_FRect *horz_rects = malloc(rows_needed * sizeof(SDL_FRect));
+  double offset_mod;
+  int64_t first_visible_row = layout_row_at(sa, g_offset_y, &offset_mod);
+  float first_row_top_y = view_y - (float)offset_mod;
+  int rows_needed =
+      (int)ceilf((content_h + (float)offset_mod) / row_full) + 1;
+  int max_v_separators = col_end - first_col + 100;
+  bool have_rects = reserve_line_rects(SDL_max(rows_needed, max_v_separators));
+  SDL_FRect *horz_rects = line_rects;
   int horz_count = 0;
 
-  int first_visible_row = (int)floorf(g_offset_y / row_full);
-
-  int total_rows = g_vscroll ? g_vscroll->total_virtual_rows : g_rows;
+  int64_t total_rows = g_vscroll ? g_vscroll->total_virtual_rows : g_rows;
 
-  for (int i = 0; i < rows_needed; i++) {
-    int current_row = first_visible_row + i;
-    if (current_row >= total_rows)
+  float row_y = first_row_top_y;
+  for (int i = 0; have_rects && i < rows_needed; i++) {
+    int64_t current_row = first_visible_row + i;
+    if (current_row >= total_rows || row_y > view_y + content_h)
       break;
 
-    float sep_y = first_row_top_y + i * row_full + cell_h;
+    float sep_y = row_y + layout_row_height(sa, current_row);
+    row_y = sep_y + line_w;
     if (sep_y + line_w < view_y || sep_y > view_y + content_h)
       continue;
     horz_rects[horz_count++] = (SDL_FRect){view_x, sep_y, content_w, line_w};
@@ -77,23 +169,25 @@ void draw_with_alloc(const SizeAlloc *sa) {
     SDL_SetRenderDrawColour(g_renderer, GRID_LINE_COLOUR);
     SDL_RenderFillRects(g_renderer, horz_rects, horz_count);
   }
-  free(horz_rects);
 
-  int max_v_separators = g_cols + 100;
-  SDL_FRect *vert_rects = malloc(max_v_separators * sizeof(SDL_FRect));
+  SDL_FRect *vert_rects = line_rects;
   int vert_count = 0;
-  for (int i = 1; i < g_cols; i++) {
-    float sep_x = view_x - g_offset_x + sa->col_left[i] - line_w;
+  /* The grid line right of the last visible column may show too */
+  int sep_end = SDL_min(col_end + 1, sa->col_count);
+  for (int i = SDL_max(first_col, 1); have_rects && i < sep_end; i++) {
+    float sep_x = view_x + (float)(sa->col_left[i] - g_offset_x) - line_w;
     if (sep_x + line_w < view_x || sep_x > view_x + content_w)
       continue;
     vert_rects[vert_count++] = (SDL_FRect){sep_x, view_y, line_w, content_h};
   }
-  if (g_cols > 0) {
-    float last_col_w = sa->col_widths[g_cols - 1];
-    float current_sep_x = view_x - g_offset_x + sa->col_left[g_cols - 1] +
-                          sa->col_widths[g_cols - 1];
+  if (have_rects && sa->col_count > 0) {
+    float last_col_w = sa->col_widths[sa->col_count - 1];
+    float current_sep_x =
+        view_x + (float)(sa->col_left[sa->col_count - 1] +
+                         sa->col_widths[sa->col_count - 1] - g_offset_x);
     int guard = 0;
-    while (current_sep_x <= view_x + content_w && guard < 10000) {
+    while (current_sep_x <= view_x + content_w && guard < 10000 &&
+           vert_count < max_v_separators) {
       if (!(current_sep_x + line_w < view_x ||
             current_sep_x > view_x + content_w)) {
         vert_rects[vert_count++] =
@@ -107,24 +201,18 @@ void draw_with_alloc(const SizeAlloc *sa) {
     SDL_SetRenderDrawColour(g_renderer, GRID_LINE_COLOUR);
     SDL_RenderFillRects(g_renderer, vert_rects, vert_count);
   }
-  free(vert_rects);
 #endif
 
   if (g_selected_index >= 0 && g_selected_row >= 0 && g_selected_col >= 0 &&
       g_selected_row < (g_vscroll ? g_vscroll->total_virtual_rows : g_rows) &&
-      g_selected_col < g_cols && g_col_left && g_col_widths) {
+      g_selected_col < sa->col_count) {
 
-    int first_visible_row = (int)floorf(g_offset_y / row_full);
-    float offset_within_first = fmodf(g_offset_y, row_full);
-    if (offset_within_first < 0.0f)
-      offset_within_first += row_full;
-    int row_offset_from_first = g_selected_row - first_visible_row;
-
-    float cell_x = view_x - g_offset_x + g_col_left[g_selected_col];
+    float cell_x =
+        view_x + (float)(sa->col_left[g_selected_col] - g_offset_x);
     float cell_y =
-        view_y + row_offset_from_first * row_full - offset_within_first;
-    float cell_wd = (float)g_col_widths[g_selected_col];
-    float cell_h = sa->row_height;
+        view_y + (float)(layout_row_top(sa, g_selected_row) - g_offset_y);
+    float cell_wd = (float)sa->col_widths[g_selected_col];
+    float cell_h = layout_row_height(sa, g_selected_row);
 
     float bw = (float)HIGHLIGHT_BORDER_WIDTH;
     float max_bw = SDL_min(cell_wd, cell_h) / 2.0f;
@@ -147,100 +235,45 @@ void draw_with_alloc(const SizeAlloc *sa) {
   }
 
   if (g_vscroll) {
-    if (g_vscroll->needs_reload)
-      goto skip_text_render;
-
-    int first_visible_row = (int)floorf(g_offset_y / row_full);
-    float offset_within_first = fmodf(g_offset_y, row_full);
-    if (offset_within_first < 0.0f)
-      offset_within_first += row_full;
+    int64_t first_visible_row = layout_row_at(sa, g_offset_y, NULL);
+    int64_t last_visible_row = layout_row_at(sa, g_offset_y + content_h, NULL);
 
-    int table_rows = g_table ? table_get_row_count(g_table) : 0;
+    int64_t table_rows = snap->row_count;
 
-    for (int virtual_row = first_visible_row;
-         virtual_row < first_visible_row + (int)ceilf(content_h / row_full) + 1;
+    /* Each row starts where the one above it ends */
+    double row_top = layout_row_top(sa, first_visible_row);
+    for (int64_t virtual_row = first_visible_row;
+         virtual_row <= last_visible_row && virtual_row < table_rows + 1;
          virtual_row++) {
 
-      if (virtual_row < 0 || virtual_row >= table_rows + 1)
-        continue;
-
-      int row_offset_from_first = virtual_row - first_visible_row;
-      float cell_y =
-          view_y + row_offset_from_first * row_full - offset_within_first;
+      int row_lines = layout_row_lines(sa, virtual_row);
+      float cell_h =
+          sa->row_height + (float)(row_lines - 1) * sa->line_height;
+      float cell_y = view_y + (float)(row_top - g_offset_y);
+      row_top += cell_h + line_w;
 
       if (cell_y + cell_h < view_y || cell_y > view_y + content_h)
         continue;
 
-      for (int c = 0; c < g_cols; c++) {
-        float cell_x = view_x - g_offset_x + sa->col_left[c];
+      for (int c = first_col; c < col_end; c++) {
+        float cell_x = view_x + (float)(sa->col_left[c] - g_offset_x);
 
         if (cell_x + sa->col_widths[c] < view_x || cell_x > view_x + content_w)
           continue;
 
-        char *cell_text = NULL;
-        int text_w = 0, text_h = 0;
-
-        if (virtual_row == 0) {
-          /* Header row */
-          cell_text = table_get_header(g_table, c);
-        } else {
-          /* Data row */
-          cell_text = table_get_cell(g_table, virtual_row - 1, c);
-        }
-
-        if (!cell_text || cell_text[0] == '\0') {
-          free(cell_text);
-          continue;
-        }
-
-        size_t len = strlen(cell_text);
-        SDL_Surface *label_surface = TTF_RenderText_LCD(
-            g_font, cell_text, len, TEXT_FONT_COLOUR, GRID_BACKGROUND_COLOUR);
-        if (!label_surface) {
-          free(cell_text);
-          continue;
-        }
-
-        text_w = label_surface->w;
-        text_h = label_surface->h;
-
-        SDL_Texture *label_texture =
-            SDL_CreateTextureFromSurface(g_renderer, label_surface);
-        SDL_DestroySurface(label_surface);
-        if (!label_texture) {
-          free(cell_text);
+        /* Header and data rows come formatted from the row cache */
+        Cell *cell = vscroll_get_cell(g_vscroll, virtual_row, c);
+        if (!cell || !cell->text || cell->text[0] == '\0')
           continue;
-        }
-
-        float padding_x = 0, padding_y = 0;
 
-#if TEXT_FONT_POSITION_HORIZONTAL == LEFT
-        padding_x = CELL_PADDING;
-#elif TEXT_FONT_POSITION_HORIZONTAL == CENTER
-        padding_x = (sa->col_widths[c] - text_w) / 2.0f;
-#elif TEXT_FONT_POSITION_HORIZONTAL == RIGHT
-        padding_x = sa->col_widths[c] - text_w - CELL_PADDING;
-#endif
-
-#if TEXT_FONT_POSITION_VERTICAL == TOP
-        padding_y = CELL_PADDING;
-#elif TEXT_FONT_POSITION_VERTICAL == CENTER
-        padding_y = (cell_h - text_h) / 2.0f;
-#elif TEXT_FONT_POSITION_VERTICAL == BOTTOM
-        padding_y = cell_h - text_h - CELL_PADDING;
-#endif
-
-        SDL_RenderTexture(g_renderer, label_texture, NULL,
-                          &(SDL_FRect){cell_x + padding_x, cell_y + padding_y,
-                                       (float)text_w, (float)text_h});
-
-        SDL_DestroyTexture(label_texture);
-        free(cell_text);
+        queue_cell_text(cell, row_lines, cell_x, cell_y,
+                        (float)sa->col_widths[c], cell_h);
       }
     }
-  }
 
-skip_text_render:
+    /* All visible text in one draw call */
+    glyph_atlas_flush(g_atlas);
+  }
 
   SDL_SetRenderClipRect(g_renderer, NULL);
 
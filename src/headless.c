@@ -0,0 +1,434 @@
+#include "include/headless.h"
+#include "include/columns.h"
+#include "include/config.h"
+#include "include/fs.h"
+#include "include/globals.h"
+#include "include/provider.h"
+#include "include/table_model.h"
+#include <SDL3/SDL.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Rows are formatted into one large buffer that is written out when full */
+typedef struct {
+  char *data;
+  size_t len;
+  bool failed;
+} OutBuf;
+
+static SDL_AtomicInt headless_done;
+
+bool headless_parse_format(const char *name, HeadlessFormat *format) {
+  if (!name || !format)
+    return false;
+  if (strcmp(name, "tsv") == 0)
+    *format = HEADLESS_TSV;
+  else if (strcmp(name, "csv") == 0)
+    *format = HEADLESS_CSV;
+  else if (strcmp(name, "ndjson") == 0)
+    *format = HEADLESS_NDJSON;
+  else
+    return false;
+  return true;
+}
+
+static void out_flush(OutBuf *out) {
+  size_t pos = 0;
+  while (pos < out->len && !out->failed) {
+    ssize_t n = write(STDOUT_FILENO, out->data + pos, out->len - pos);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "Failed to write output: %s\n", strerror(errno));
+      out->failed = true;
+      break;
+    }
+    pos += (size_t)n;
+  }
+  out->len = 0;
+}
+
+static void out_write(OutBuf *out, const char *s, size_t len) {
+  while (len > 0 && !out->failed) {
+    if (out->len == HEADLESS_OUTPUT_BUFFER_SIZE)
+      out_flush(out);
+    size_t n = HEADLESS_OUTPUT_BUFFER_SIZE - out->len;
+    if (n > len)
+      n = len;
+    memcpy(out->data + out->len, s, n);
+    out->len += n;
+    s += n;
+    len -= n;
+  }
+}
+
+static void out_char(OutBuf *out, char c) {
+  if (out->len == HEADLESS_OUTPUT_BUFFER_SIZE)
+    out_flush(out);
+  if (!out->failed)
+    out->data[out->len++] = c;
+}
+
+/* TSV: tabs, newlines, carriage returns and backslashes are escaped as \t,
+ * \n, \r and \\ */
+static void write_tsv_field(OutBuf *out, const char *s) {
+  const char *run = s;
+  for (; *s; s++) {
+    const char *esc = NULL;
+    switch (*s) {
+    case '\t':
+      esc = "\\t";
+      break;
+    case '\n':
+      esc = "\\n";
+      break;
+    case '\r':
+      esc = "\\r";
+      break;
+    case '\\':
+      esc = "\\\\";
+      break;
+    default:
+      continue;
+    }
+    out_write(out, run, (size_t)(s - run));
+    out_write(out, esc, 2);
+    run = s + 1;
+  }
+  out_write(out, run, (size_t)(s - run));
+}
+
+/* CSV (RFC 4180): quoted only when needed, quotes doubled */
+static void write_csv_field(OutBuf *out, const char *s) {
+  if (!s[strcspn(s, ",\"\r\n")]) {
+    out_write(out, s, strlen(s));
+    return;
+  }
+
+  out_char(out, '"');
+  const char *run = s;
+  for (; *s; s++) {
+    if (*s == '"') {
+      out_write(out, run, (size_t)(s - run + 1));
+      out_char(out, '"');
+      run = s + 1;
+    }
+  }
+  out_write(out, run, (size_t)(s - run));
+  out_char(out, '"');
+}
+
+/* Length of the well-formed UTF-8 sequence a non-ASCII byte starts, 0 if
+ * it starts none: stray continuation bytes, overlong forms, surrogates,
+ * code points past U+10FFFF and truncated sequences */
+static int utf8_sequence_len(const unsigned char *s) {
+  int len;
+  unsigned char lo = 0x80, hi = 0xBF; /* allowed range of the second byte */
+  if (s[0] >= 0xC2 && s[0] <= 0xDF) {
+    len = 2;
+  } else if (s[0] >= 0xE0 && s[0] <= 0xEF) {
+    len = 3;
+    if (s[0] == 0xE0)
+      lo = 0xA0;
+    else if (s[0] == 0xED)
+      hi = 0x9F;
+  } else if (s[0] >= 0xF0 && s[0] <= 0xF4) {
+    len = 4;
+    if (s[0] == 0xF0)
+      lo = 0x90;
+    else if (s[0] == 0xF4)
+      hi = 0x8F;
+  } else {
+    return 0;
+  }
+
+  if (s[1] < lo || s[1] > hi)
+    return 0;
+  for (int i = 2; i < len; i++) {
+    if (s[i] < 0x80 || s[i] > 0xBF)
+      return 0;
+  }
+  return len;
+}
+
+/* JSON string with quotes; control characters become escapes. File names
+ * are bytes, not necessarily UTF-8: every byte that is not part of a
+ * well-formed sequence is written as U+FFFD */
+static void write_json_string(OutBuf *out, const char *s) {
+  out_char(out, '"');
+  const char *run = s;
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c >= 0x80) {
+      int len = utf8_sequence_len((const unsigned char *)s);
+      if (len > 0) {
+        s += len - 1;
+        continue;
+      }
+      out_write(out, run, (size_t)(s - run));
+      out_write(out, "\xEF\xBF\xBD", 3);
+      run = s + 1;
+      continue;
+    }
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    out_write(out, run, (size_t)(s - run));
+    char esc[8];
+    switch (c) {
+    case '"':
+      out_write(out, "\\\"", 2);
+      break;
+    case '\\':
+      out_write(out, "\\\\", 2);
+      break;
+    case '\n':
+      out_write(out, "\\n", 2);
+      break;
+    case '\t':
+      out_write(out, "\\t", 2);
+      break;
+    default:
+      snprintf(esc, sizeof esc, "\\u%04x", c);
+      out_write(out, esc, 6);
+      break;
+    }
+    run = s + 1;
+  }
+  out_write(out, run, (size_t)(s - run));
+  out_char(out, '"');
+}
+
+/* Field names for the header line and NDJSON keys; header templates are not
+ * used because their totals are only known at the end */
+static const char *column_key(TableModel *table, int col, char *buf,
+                              size_t cap) {
+  ColumnDef *def = table_get_column(table, col);
+  switch (def ? def->type : COL_CUSTOM) {
+  case COL_PATH:
+    return "path";
+  case COL_SIZE:
+    return "size";
+  case COL_DATE:
+    return "date";
+  case COL_PERMS:
+    return "permissions";
+  default:
+    snprintf(buf, cap, "column%d", col);
+    return buf;
+  }
+}
+
+static void write_field(OutBuf *out, HeadlessFormat format, const char *s) {
+  switch (format) {
+  case HEADLESS_TSV:
+    write_tsv_field(out, s);
+    break;
+  case HEADLESS_CSV:
+    write_csv_field(out, s);
+    break;
+  case HEADLESS_NDJSON:
+    write_json_string(out, s);
+    break;
+  }
+}
+
+static void write_header(OutBuf *out, TableModel *table,
+                         HeadlessFormat format) {
+  if (format == HEADLESS_NDJSON)
+    return;
+
+  char key[32];
+  int cols = table_get_col_count(table);
+  for (int c = 0; c < cols; c++) {
+    if (c > 0)
+      out_char(out, format == HEADLESS_CSV ? ',' : '\t');
+    write_field(out, format, column_key(table, c, key, sizeof key));
+  }
+  out_char(out, '\n');
+}
+
+/* Cells fetched from the table a range of rows at a time */
+typedef struct {
+  char *text;
+  size_t cap;
+  size_t *offsets; /* [row][col] */
+} CellRange;
+
+static void write_row(OutBuf *out, TableModel *table, HeadlessFormat format,
+                      const CellRange *cells, int index, int cols) {
+  char key[32];
+  const size_t *offsets = cells->offsets + (size_t)index * cols;
+
+  if (format == HEADLESS_NDJSON)
+    out_char(out, '{');
+  for (int c = 0; c < cols; c++) {
+    if (c > 0)
+      out_char(out, format == HEADLESS_TSV ? '\t' : ',');
+    if (format == HEADLESS_NDJSON) {
+      write_json_string(out, column_key(table, c, key, sizeof key));
+      out_char(out, ':');
+    }
+    write_field(out, format, cells->text + offsets[c]);
+  }
+  if (format == HEADLESS_NDJSON)
+    out_char(out, '}');
+  out_char(out, '\n');
+}
+
+/* Write rows [begin, end); returns the first row not written */
+static int64_t write_rows(OutBuf *out, TableModel *table,
+                          HeadlessFormat format, const CellRange *cells,
+                          int64_t begin, int64_t end) {
+  int cols = table_get_col_count(table);
+  while (begin < end && !out->failed) {
+    int n = table_format_cells(table, begin,
+                               SDL_min(end, begin + HEADLESS_FETCH_ROWS),
+                               NULL, cols, cells->text, cells->cap,
+                               cells->offsets);
+    if (n == 0)
+      break;
+    for (int i = 0; i < n; i++)
+      write_row(out, table, format, cells, i, cols);
+    begin += n;
+  }
+  return begin;
+}
+
+static int headless_traverse(void *arg) {
+  int ret = traverse_fs(arg);
+  SDL_SetAtomicInt(&headless_done, 1);
+  return ret;
+}
+
+static double elapsed_seconds(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int headless_run(const char *dir_path, HeadlessFormat format) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  OutBuf out = {0};
+  out.data = malloc(HEADLESS_OUTPUT_BUFFER_SIZE);
+  if (!out.data) {
+    fprintf(stderr, "Failed to allocate output buffer\n");
+    return 1;
+  }
+
+  DataProvider *provider = provider_create_filesystem(dir_path);
+  ColumnRegistry *cols = cols_create();
+  if (!provider || !cols) {
+    fprintf(stderr, "Failed to create table model\n");
+    if (provider)
+      provider_destroy(provider);
+    cols_destroy(cols);
+    free(out.data);
+    return 1;
+  }
+
+  if (!cols_add(cols, col_path_default()) ||
+      !cols_add(cols, col_size_default()) ||
+      !cols_add(cols, col_date_default()) ||
+      !cols_add(cols, col_perms_default())) {
+    fprintf(stderr, "Failed to add columns\n");
+    cols_destroy(cols);
+    provider_destroy(provider);
+    free(out.data);
+    return 1;
+  }
+
+  g_table = table_create(provider, cols);
+  if (!g_table) {
+    fprintf(stderr, "Failed to create table model\n");
+    cols_destroy(cols);
+    provider_destroy(provider);
+    free(out.data);
+    return 1;
+  }
+
+  /* Twice the worst case of one row, normally room for the whole range */
+  int cols_count = table_get_col_count(g_table);
+  CellRange cells = {0};
+  cells.cap = (size_t)SDL_max(cols_count, 1) * TABLE_CELL_MAX * 2;
+  cells.text = malloc(cells.cap);
+  cells.offsets = malloc((size_t)HEADLESS_FETCH_ROWS *
+                         SDL_max(cols_count, 1) * sizeof *cells.offsets);
+  if (!cells.text || !cells.offsets) {
+    fprintf(stderr, "Failed to allocate output buffer\n");
+    free(cells.text);
+    free(cells.offsets);
+    table_destroy(g_table);
+    g_table = NULL;
+    free(out.data);
+    return 1;
+  }
+
+  write_header(&out, g_table, format);
+
+  char *thread_dir = strdup(dir_path);
+  SDL_SetAtomicInt(&headless_done, 0);
+  g_fs_traversing = true;
+  g_stop = false;
+  SDL_Thread *fs_thread =
+      thread_dir ? SDL_CreateThread(headless_traverse, "FS Traversal",
+                                    thread_dir)
+                 : NULL;
+  if (!fs_thread) {
+    fprintf(stderr, "Failed to create thread: %s\n", SDL_GetError());
+    free(thread_dir);
+    free(cells.text);
+    free(cells.offsets);
+    table_destroy(g_table);
+    g_table = NULL;
+    free(out.data);
+    return 1;
+  }
+
+  /* Rows are written as soon as traversal publishes them. Checking for the
+   * end before draining guarantees the last batches are not missed */
+  int64_t written = 0;
+  for (;;) {
+    bool finished = SDL_GetAtomicInt(&headless_done) != 0;
+    fs_drain(g_table);
+
+    int64_t rows = table_get_row_count(g_table);
+    bool idle = written == rows;
+    written = write_rows(&out, g_table, format, &cells, written, rows);
+
+    if (out.failed) {
+      g_stop = true;
+      break;
+    }
+    if (finished)
+      break;
+    if (idle)
+      SDL_DelayNS(HEADLESS_POLL_NS);
+  }
+
+  SDL_WaitThread(fs_thread, NULL);
+  fs_drain(g_table); /* anything left after a stop, freed with the table */
+  out_flush(&out);
+
+  FsTotals totals = fs_get_totals();
+  double seconds = elapsed_seconds(&start);
+  fprintf(stderr, "%" PRId64 " rows, %llu bytes in %.3f s (%.0f rows/s)\n",
+          written, totals.bytes, seconds,
+          seconds > 0 ? (double)written / seconds : 0.0);
+
+  bool failed = out.failed;
+  free(cells.text);
+  free(cells.offsets);
+  free(out.data);
+  table_destroy(g_table);
+  g_table = NULL;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+/* arena.h */
+#include <stddef.h>
+
+/* Bump allocator: allocations are carved out of large chunks and released
+ * all at once. Not thread-safe; give every thread its own arena. */
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+  ArenaChunk *head;
+  size_t chunk_size;
+} Arena;
+
+/* Initialise an empty arena; chunks of `chunk_size` bytes are allocated on
+ * demand (bigger requests get a chunk of their own) */
+void arena_init(Arena *arena, size_t chunk_size);
+
+/* Allocate `size` bytes aligned to `align` (a power of two, at most
+ * alignof(max_align_t)).
+ * Returns NULL on allocation failure */
+void *arena_alloc(Arena *arena, size_t size, size_t align);
+
+/* Copy `len` bytes of `s` and terminate with '\0' */
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+
+/* Release every chunk; the arena can be reused afterwards */
+void arena_free(Arena *arena);
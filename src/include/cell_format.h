@@ -0,0 +1,37 @@
+#pragma once
+/* cell_format.h */
+#include "template.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Formatting kernels for the numeric columns: sizes through a two digits
+ * at a time integer conversion, permissions through lookup tables. The
+ * column forms format a run of values in one pass with the contract of
+ * table_format_cells(): cells one after another in text, each terminated,
+ * offsets[i] where each starts; they stop before the first value that does
+ * not fit and return how many were formatted. */
+
+/* Longest size cell with its terminator ("-9223372036854775808") */
+#define CELL_FORMAT_SIZE_MAX 24
+
+/* Decimal digits of v into buf (at least 21 bytes), terminated. Returns
+ * the length */
+size_t cell_format_u64(unsigned long long v, char *buf);
+
+/* Size in bytes, or with `human` in B/KiB/MiB/... with one decimal
+ * ("1.5 KiB"). buf holds CELL_FORMAT_SIZE_MAX bytes */
+size_t cell_format_size(long long size, bool human, char *buf);
+
+/* Permissions of `mode` by a template compiled with COL_PERM_FIELDS (see
+ * PERM_TEMPLATE) into buf; returns the length written */
+size_t cell_format_mode(mode_t mode, const Template *tpl, char *buf,
+                        size_t cap);
+
+/* Classic ls form ("drwxr-xr-x") into buf (at least 11 bytes) */
+size_t cell_format_mode_ls(mode_t mode, char *buf);
+
+int cell_format_sizes(const long long *sizes, int count, bool human,
+                      char *text, size_t cap, size_t *offsets);
+int cell_format_modes(const mode_t *modes, int count, const Template *tpl,
+                      char *text, size_t cap, size_t *offsets);
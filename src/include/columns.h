@@ -1,6 +1,9 @@
 #pragma once
 
+#include "date_format.h"
+#include "template.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef enum {
   COL_PATH,
@@ -21,6 +24,27 @@ typedef struct {
   /* Custom renderers (if type == COL_CUSTOM) */
   char *(*render_cell)(void *user_data, void *row_data);
   char *(*render_header)(void *user_data);
+
+  /* Format a cell into buf (always terminated, truncated to cap - 1).
+   * Returns the length written. Preferred over render_cell; gets the
+   * ColumnDef itself as user_data */
+  size_t (*format_cell)(void *user_data, void *row_data, char *buf,
+                        size_t cap);
+
+  /* Optional bulk form of format_cell for a run of rows (all row data
+   * non-NULL), at most COLUMN_BULK_ROWS at a time. Cells go into text one
+   * after another, each terminated, offsets[i] where each starts; stops
+   * before the first cell that does not fit and returns how many were
+   * formatted */
+  int (*format_column)(void *user_data, void *const *rows, int count,
+                       char *text, size_t cap, size_t *offsets);
+
+  /* cell_template and header_template compiled by cols_add/cols_insert;
+   * owned by the registry */
+  Template *cell_tpl;
+  Template *header_tpl;
+  /* COL_DATE: cell_template as a memoizing date format */
+  DateFormat *date_fmt;
 } ColumnDef;
 
 typedef struct {
@@ -32,14 +56,24 @@ typedef struct {
 /* Create empty column registry */
 ColumnRegistry *cols_create(void);
 
-/* Add column to the end */
-void cols_add(ColumnRegistry *reg, ColumnDef col);
+/* Most rows a format_column call handles */
+#define COLUMN_BULK_ROWS 64
+
+/* Fields of path cell templates: %n name, %f full path, %F resolved path,
+ * %d directory, %r and %P traversal root */
+#define COL_PATH_FIELDS "nfFdrP"
+/* Fields of permission templates, see PERM_TEMPLATE */
+#define COL_PERM_FIELDS "nTSugoUGO"
+
+/* Add column to the end. Its templates are compiled here; false when that
+ * or the allocation fails, the column is then not added */
+bool cols_add(ColumnRegistry *reg, ColumnDef col);
 
 /* Remove column at index */
 void cols_remove(ColumnRegistry *reg, int col_idx);
 
-/* Insert column at specific index */
-void cols_insert(ColumnRegistry *reg, int col_idx, ColumnDef col);
+/* Insert column at specific index; false like cols_add() */
+bool cols_insert(ColumnRegistry *reg, int col_idx, ColumnDef col);
 
 /* Move column from src to dst index */
 void cols_move(ColumnRegistry *reg, int src_idx, int dst_idx);
@@ -14,6 +14,43 @@
 
 #define BATCH_SIZE 100
 
+/* Buffer a cell is formatted into; longer text is truncated. Fits the
+ * longest path with its symlink target */
+#define TABLE_CELL_MAX 8192
+/* Columns with a bulk formatter a table_format_cells() pass handles, and
+ * the text each of them fills per pass */
+#define TABLE_BULK_COLS 4
+#define TABLE_BULK_TEXT 4096
+/* Rows drained from traversal that are measured per frame, outside the
+ * grid lock; the rest waits for the following frames */
+#define TABLE_MEASURE_BUDGET 2048
+
+/* Size of the chunks entry names and directory nodes are allocated from.
+ * Every traversal worker fills its own chunks */
+#define FS_ARENA_CHUNK_SIZE (1024 * 1024)
+
+/* Number of directory traversal workers. Every worker owns a deque of
+ * subdirectories still to be listed and steals from the others when its own
+ * deque runs dry. 0 means one worker per logical CPU core. */
+#define FS_WORKER_THREADS 0
+#define FS_MAX_WORKERS 64
+/* How long an idle worker sleeps before looking for work to steal again */
+#define FS_IDLE_SLEEP_NS 50000
+/* Per-worker buffer for raw getdents64() directory reads */
+#define FS_GETDENTS_BUFFER_SIZE (256 * 1024)
+/* Stat directory entries in batches through io_uring (IORING_OP_STATX).
+ * Falls back to fstatat() when the kernel does not allow io_uring. */
+#define FS_WITH_IO_URING
+#define FS_URING_DEPTH 256
+
+/* Headless mode (--format): rows are collected in a buffer of this size and
+ * written to stdout with one write() when it fills up */
+#define HEADLESS_OUTPUT_BUFFER_SIZE (1024 * 1024)
+/* Rows formatted per table_format_cells() call */
+#define HEADLESS_FETCH_ROWS 256
+/* How long headless mode waits for traversal when no rows are ready */
+#define HEADLESS_POLL_NS 1000000
+
 /* Template for PERM_SYMBOLIC format:
  * %n - numeric permissions ([0-6]{4})
  * %T - file type (d/l/-/c/b/p/s/?)
@@ -34,6 +71,8 @@
 #define PERM_TEMPLATE "%S %T %u %g %o"
 
 // #define SHOW_FILE_RELATIVE_PATH
+/* Show sizes as "1.5 KiB" instead of bytes */
+// #define SIZE_HUMAN_READABLE
 #define WITH_BORDER
 #define BORDER_COLOUR (SDL_Color){100, 100, 100, 255}
 #define BORDER_WIDTH 2
@@ -64,7 +103,19 @@
 #define TEXT_FONT_POSITION_HORIZONTAL LEFT
 #define TEXT_FONT_POSITION_VERTICAL BOTTOM
 #define TEXT_FONT_COLOUR (SDL_Color){100, 100, 100, 255}
+/* Side of the square texture glyphs are cached in, and how many distinct
+ * glyphs it tracks (power of two). When either runs out it is refilled */
+#define GLYPH_ATLAS_SIZE 1024
+#define GLYPH_ATLAS_MAX_GLYPHS 2048
+/* Non-ASCII code points whose advance text measurement keeps (power of
+ * two); when full it starts over */
+#define TEXT_MEASURE_CACHE_GLYPHS 4096
 #define CELL_PADDING 10
+/* Cells show their text line by line; a row is as tall as its cell with
+ * the most lines, up to ROW_MAX_LINES. Row heights are indexed in blocks
+ * of ROW_INDEX_BLOCK rows (see row_index.h) */
+#define ROW_MAX_LINES 8
+#define ROW_INDEX_BLOCK 256
 
 #define SCROLLBAR_WIDTH 20
 #define SCROLL_SPEED 50
@@ -81,6 +132,8 @@
  * You can override this macro to use other formats.
  */
 #define DATE_FORMAT_TEMPLATE "%H:%M:%S %d %B %Y"
+/* Days whose formatted date is memoized (see date_format.h) */
+#define DATE_FORMAT_CACHE_DAYS 256
 
 /* --- Header templates (user-configurable) ---
  * Supported substitutions:
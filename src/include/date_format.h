@@ -0,0 +1,30 @@
+#pragma once
+/* date_format.h */
+#include <stddef.h>
+#include <time.h>
+
+/* strftime() for many timestamps. The format is split once into parts that
+ * only depend on the calendar day and the %H, %M, %S digits (also inside
+ * %T and %R). Each local day is formatted once and memoized; a timestamp
+ * then costs a copy of its day plus patching six digits. Days with a UTC
+ * offset change (DST) and formats with other time-of-day specifiers (%c,
+ * %I, %p, %s, flags, ...) go through localtime_r() and strftime() every
+ * time, so the output is always the same as strftime's.
+ *
+ * Not thread-safe: the memo is shared, callers serialize (the table
+ * mutex does). */
+typedef struct DateFormat DateFormat;
+
+/* NULL when out of memory */
+DateFormat *date_format_create(const char *fmt);
+void date_format_free(DateFormat *df);
+
+/* Format t into buf like strftime(): "" when it does not fit in cap, "???"
+ * when t cannot be converted. Returns the length */
+size_t date_format(DateFormat *df, time_t t, char *buf, size_t cap);
+
+/* A run of timestamps with the contract of cell_format_sizes(): cells one
+ * after another in text, each terminated, offsets[i] where each starts;
+ * stops before the first one that does not fit */
+int date_format_times(DateFormat *df, const time_t *times, int count,
+                      char *text, size_t cap, size_t *offsets);
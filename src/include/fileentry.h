@@ -1,16 +1,31 @@
 #pragma once
 
 #include <stdbool.h>
-#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* Directory an entry was found in. Interned once per directory and shared by
+ * all of its entries; path strings are rebuilt from the chain on demand
+ * (see fs_entry_full_path() and friends in fs.h). */
+typedef struct DirNode {
+  const struct DirNode *parent; /* NULL for the traversal root */
+  const char *name; /* component; the root keeps the path as passed */
+  unsigned short name_len;
+} DirNode;
 
 typedef struct {
-  char *name;
-  char *full_path;
-  char *resolved_path;
-  char *dir_path;
-  char *root_path;
+  const char *name; /* display name */
+  const DirNode *dir;
+  const char *resolved_path; /* filled by fs_entry_resolved_path() on use */
+
+  /* Only the stat fields columns show. Until has_stat is set, only the
+   * S_IFMT bits of mode are valid; use fs_entry_ensure_stat() first */
+  off_t size;
+  time_t mtime;
+  mode_t mode;
 
-  struct stat st;
+  bool has_stat;
+  bool resolved_checked;
   bool is_regular_file;
   bool is_broken_symlink;
-} FileEntry;
\ No newline at end of file
+} FileEntry;
@@ -1,8 +1,54 @@
 #pragma once
 /* fs.h */
+#include "fileentry.h"
+#include "table_model.h"
+#include <sys/stat.h>
 
 int traverse_fs(void *arg);
 
-/* Render header template with substitutions (%P, %p, %b, %f, %d, %%)
- * Returns malloc'd string (caller must free) */
-char *render_header_template(const char *tmpl);
\ No newline at end of file
+typedef struct {
+  /* Суммарный размер всех найденных файлов и директорий как они
+   * отображаются на диске */
+  unsigned long long bytes;
+  /* Суммарный размер только обычных файлов (без директорий) */
+  unsigned long long file_bytes;
+  /* Реальный размер на диске (блоки, с учётом фрагментации и метаданных) */
+  unsigned long long disk_bytes;
+} FsTotals;
+
+/* Totals of the current traversal, merged from the per-worker counters */
+FsTotals fs_get_totals(void);
+
+/* Append rows published by traversal workers since the last call.
+ * Call from the thread that owns the table (the UI thread), once per frame;
+ * it never waits on traversal. Returns number of rows added. */
+int fs_drain(TableModel *table);
+
+/* Fields of header templates: %P canonical and %p original root path,
+ * %b, %f and %d totals (see HEADER_TEMPLATE_0) */
+#define FS_HEADER_FIELDS "Ppbfd"
+
+/* Expand a header template compiled with FS_HEADER_FIELDS into buf (always
+ * terminated, truncated to cap - 1); returns the length written */
+size_t fs_format_header(const Template *tpl, char *buf, size_t cap);
+
+/* Loads stat data of an entry. Traversal skips stat() when no column or
+ * header needs it; call this before reading size, mtime or mode. */
+void fs_entry_ensure_stat(FileEntry *entry);
+
+/* Paths are not stored per entry; these build them from the interned
+ * directory chain into buf. Return the length, 0 (and "") if it did not fit */
+size_t fs_entry_full_path(const FileEntry *entry, char *buf, size_t cap);
+size_t fs_entry_dir_path(const FileEntry *entry, char *buf, size_t cap);
+
+/* Traversal root as it was passed */
+const char *fs_entry_root_path(const FileEntry *entry);
+
+/* Name shown for an entry: the path relative to the root with
+ * SHOW_FILE_RELATIVE_PATH (built into buf), the bare name otherwise */
+const char *fs_entry_display_name(const FileEntry *entry, char *buf,
+                                  size_t cap);
+
+/* Canonical (realpath) path of an entry, computed on first use and cached.
+ * Falls back to the full path, built into buf, when it cannot be resolved. */
+const char *fs_entry_resolved_path(FileEntry *entry, char *buf, size_t cap);
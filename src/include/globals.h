@@ -1,17 +1,22 @@
 /* include/globals.h */
 #pragma once
 
+#include "glyph_atlas.h"
 #include "table_model.h"
+#include "text_measure.h"
 #include "types.h"
 #include "virtual_scroll.h"
 #include <SDL3/SDL.h>
 #include <SDL3_ttf/SDL_ttf.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /* Globals (defined in src/globals.c) */
 extern SDL_Renderer *g_renderer;
 extern SDL_Window *g_window;
 extern TTF_Font *g_font;
+extern GlyphAtlas *g_atlas;
+extern TextMeasure *g_measure;
 
 /* NEW: Table model replaces direct grid access */
 extern TableModel *g_table;
@@ -21,19 +26,20 @@ extern Cell **g_grid;
 extern int g_rows;
 extern int g_cols;
 
-extern float g_offset_x;
-extern float g_offset_y;
+/* Scroll position in the virtual grid, see SizeAlloc.total_grid_h */
+extern double g_offset_x;
+extern double g_offset_y;
 
 extern bool g_dragging_vert;
 extern bool g_dragging_horz;
 extern float g_drag_start_pos;
-extern float g_drag_start_offset;
+extern double g_drag_start_offset;
 
 extern bool g_need_horz;
 extern bool g_need_vert;
 
-extern float g_total_grid_w;
-extern float g_total_grid_h;
+extern double g_total_grid_w;
+extern double g_total_grid_h;
 extern float g_content_w;
 extern float g_content_h;
 extern float g_view_x;
@@ -45,15 +51,12 @@ extern float g_view_h;
 extern FILE *g_log_file;
 
 /* Smooth scroll targets */
-extern float g_scroll_target_x;
-extern float g_scroll_target_y;
+extern double g_scroll_target_x;
+extern double g_scroll_target_y;
 
 /* Mutex for grid access */
 extern SDL_Mutex *g_grid_mutex;
 
-/* Max column widths */
-extern int *g_max_col_widths;
-
 /* FS traversal flag */
 extern bool g_fs_traversing;
 
@@ -61,28 +64,19 @@ extern bool g_fs_traversing;
 extern volatile bool g_stop;
 
 /* Selection state (indexing) */
-extern int g_selected_row;
+extern int64_t g_selected_row;
 extern int g_selected_col;
-extern int g_selected_index;
+extern int64_t g_selected_index;
 
-/* Row height and column geometry cached for event hit-testing */
+/* Row height cached for event hit-testing */
 extern float g_row_height;
-extern float *g_col_left;
-extern int *g_col_widths;
+
+/* Layout of the current frame, kept between frames by sizeAllocate();
+ * read-only everywhere else */
+extern SizeAlloc g_layout;
 
 /* Virtual scrolling */
 extern VirtualScrollState *g_vscroll;
-extern float g_last_content_h;
-
-/* Суммарный размер всех найденных файлов и директорий как они отображаются на
- * диске */
-extern unsigned long long g_total_bytes;
-
-/* Суммарный размер только обычных файлов (без директорий) */
-extern unsigned long long g_total_file_bytes;
-
-/* Реальный размер на диске (блоки, с учётом фрагментации и метаданных) */
-extern unsigned long long g_total_disk_bytes;
 
 /* Prototypes */
 void cleanup(void);
\ No newline at end of file
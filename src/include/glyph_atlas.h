@@ -0,0 +1,30 @@
+#pragma once
+/* glyph_atlas.h */
+#include <SDL3/SDL.h>
+#include <SDL3_ttf/SDL_ttf.h>
+#include <stdbool.h>
+
+/* Glyphs of one font rasterised once into a texture. Text is drawn by
+ * queueing a quad per glyph and submitting the whole queue in a single
+ * SDL_RenderGeometry call. */
+typedef struct GlyphAtlas GlyphAtlas;
+
+/* Create an empty atlas; glyphs are added on first use. fg/bg are the
+ * colours passed to TTF_RenderGlyph_LCD */
+GlyphAtlas *glyph_atlas_create(SDL_Renderer *renderer, TTF_Font *font,
+                               SDL_Color fg, SDL_Color bg);
+
+void glyph_atlas_destroy(GlyphAtlas *atlas);
+
+/* Line height of the font */
+int glyph_atlas_line_height(const GlyphAtlas *atlas);
+
+/* Width of `len` bytes of UTF-8 text as glyph_atlas_queue_text() lays it out */
+float glyph_atlas_text_width(GlyphAtlas *atlas, const char *text, size_t len);
+
+/* Queue text with its top-left corner at (x, y) */
+void glyph_atlas_queue_text(GlyphAtlas *atlas, const char *text, size_t len,
+                            float x, float y);
+
+/* Draw everything queued since the last flush */
+void glyph_atlas_flush(GlyphAtlas *atlas);
@@ -2,4 +2,7 @@
 /* grid.h */
 #include "types.h"
 
-void draw_with_alloc(const SizeAlloc *sa);
+void draw_with_alloc(const SizeAlloc *sa, const FrameSnapshot *snap);
+
+/* Free what drawing keeps between frames */
+void grid_free(void);
@@ -0,0 +1,18 @@
+#pragma once
+/* headless.h */
+#include <stdbool.h>
+
+/* Output formats of the headless listing */
+typedef enum {
+  HEADLESS_TSV,
+  HEADLESS_CSV,
+  HEADLESS_NDJSON,
+} HeadlessFormat;
+
+/* Parse a --format argument ("tsv", "csv", "ndjson") */
+bool headless_parse_format(const char *name, HeadlessFormat *format);
+
+/* Traverse dir_path and stream every row to stdout while traversal runs.
+ * Neither a window nor a font is created. A summary with the timing goes to
+ * stderr. Returns the process exit status */
+int headless_run(const char *dir_path, HeadlessFormat format);
@@ -1,5 +1,31 @@
 #pragma once
 /* layout.h */
 #include "types.h"
+#include <stdint.h>
 
-SizeAlloc sizeAllocate(int win_w, int win_h);
+/* Lay out the table into g_layout and return it. The layout persists
+ * between frames and is only recomputed when the window size, the column
+ * set, a column width or the row count changed since the last call */
+const SizeAlloc *sizeAllocate(int win_w, int win_h, const FrameSnapshot *snap);
+
+/* Free the column arrays of a layout */
+void layout_free(SizeAlloc *sa);
+
+/* Rows have the height of their lines (see table_get_row_lines()); the
+ * header is one line. All of these are O(log rows) */
+
+/* Virtual row (0 is the header) at virtual y, and how far into it y is in
+ * *within (may be NULL) */
+int64_t layout_row_at(const SizeAlloc *sa, double y, double *within);
+
+/* Virtual y of the top of a row */
+double layout_row_top(const SizeAlloc *sa, int64_t row);
+
+/* Lines of a virtual row, and its height without the grid line */
+int layout_row_lines(const SizeAlloc *sa, int64_t row);
+float layout_row_height(const SizeAlloc *sa, int64_t row);
+
+/* Column whose left edge is the last at or before virtual x: the column x
+ * is in or the grid line right of it (the first column for x before it).
+ * -1 without columns. O(log columns) */
+int layout_col_at(const SizeAlloc *sa, double x);
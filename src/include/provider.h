@@ -1,26 +1,50 @@
 #pragma once
 
+#include "arena.h"
 #include "fileentry.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-/* Data provider interface for different data sources */
+/* Data provider interface for different data sources. Rows are indexed
+ * with 64 bits, so a provider is not limited to INT_MAX rows */
 typedef struct {
   /* Get total number of rows */
-  int (*row_count)(void *provider_ctx);
+  int64_t (*row_count)(void *provider_ctx);
 
   /* Get rendered cell text for given row and column.
    * Returns malloc'd string (caller must free) */
-  char *(*get_cell)(void *provider_ctx, int row, int col);
+  char *(*get_cell)(void *provider_ctx, int64_t row, int col);
+
+  /* Optional: format the cell into buf instead (always terminated,
+   * truncated to cap - 1). Returns the length written */
+  size_t (*format_cell)(void *provider_ctx, int64_t row, int col, char *buf,
+                        size_t cap);
+
+  /* Optional: format the cells of rows [row_begin, row_end) in columns
+   * cols[0..ncols) (the first ncols columns if cols is NULL) in one call,
+   * for providers that format in bulk. Same contract as
+   * table_format_cells(): cells go into text one after another, each
+   * terminated, offsets[(row - row_begin) * ncols + i] gets where each
+   * starts. Stops before the first row that does not fit in cap; returns
+   * the number of rows formatted */
+  int (*format_cells)(void *provider_ctx, int64_t row_begin, int64_t row_end,
+                      const int *cols, int ncols, char *text, size_t cap,
+                      size_t *offsets);
 
   /* Get raw row data (FileEntry pointer for FS, etc).
    * May return NULL for merged/virtual rows */
-  void *(*get_row_data)(void *provider_ctx, int row);
+  void *(*get_row_data)(void *provider_ctx, int64_t row);
 
   /* Add row at position. Data ownership depends on provider */
-  bool (*insert_row)(void *provider_ctx, int row, void *data);
+  bool (*insert_row)(void *provider_ctx, int64_t row, void *data);
+
+  /* Optional: append many rows at the end in one call.
+   * NULL means insert_row is called for each row */
+  bool (*append_rows)(void *provider_ctx, void **data, int count);
 
   /* Remove row at position */
-  bool (*delete_row)(void *provider_ctx, int row);
+  bool (*delete_row)(void *provider_ctx, int64_t row);
 
   /* Cleanup provider context */
   void (*destroy)(void *provider_ctx);
@@ -34,6 +58,12 @@ typedef struct {
 /* Create filesystem provider that traverses directory */
 DataProvider *provider_create_filesystem(const char *path);
 
+/* Storage of a filesystem provider's rows. Traversal worker `worker`
+ * allocates entries from its own arena; the render arena is for strings
+ * computed later on the UI thread. NULL for other providers */
+Arena *provider_fs_arena(DataProvider *p, int worker);
+Arena *provider_fs_render_arena(DataProvider *p);
+
 /* Create dual-pane provider combining two directories side-by-side */
 DataProvider *provider_create_dual(DataProvider *left, DataProvider *right);
 
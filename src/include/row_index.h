@@ -0,0 +1,40 @@
+#pragma once
+/* row_index.h */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Heights of the rows of a table in text lines, indexed for tables of any
+ * length. Rows go in blocks of ROW_INDEX_BLOCK and a Fenwick tree keeps the
+ * lines of each block: the lines above a row cost O(log n) plus a scan of
+ * its block, the row at a given height is found by descending the tree, and
+ * a row changing its lines costs O(log n). Rows inserted or deleted
+ * anywhere but at the end move the rows after them and rebuild the tree.
+ *
+ * Pixels are left to the caller: a row of n lines is n * line_px + row_px
+ * high. Rows past the last one count as rows of one line. Not thread-safe;
+ * the table mutex serializes it. */
+typedef struct RowIndex RowIndex;
+
+/* NULL when out of memory */
+RowIndex *row_index_create(void);
+void row_index_destroy(RowIndex *ri);
+
+/* Insert count rows of one line before row. False when out of memory */
+bool row_index_insert(RowIndex *ri, int64_t row, int64_t count);
+
+/* Delete rows [row, row + count) */
+void row_index_remove(RowIndex *ri, int64_t row, int64_t count);
+
+int64_t row_index_count(const RowIndex *ri);
+
+/* Lines of a row, and setting them (clamped to 1..ROW_MAX_LINES) */
+int row_index_get(const RowIndex *ri, int64_t row);
+void row_index_set(RowIndex *ri, int64_t row, int lines);
+
+/* Lines of rows [0, row) */
+int64_t row_index_lines_before(const RowIndex *ri, int64_t row);
+
+/* Row that pixel y (from the top of row 0) falls in; the y of its top goes
+ * to *top */
+int64_t row_index_find(const RowIndex *ri, double y, double row_px,
+                       double line_px, double *top);
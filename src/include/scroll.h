@@ -1,6 +1,10 @@
 #pragma once
 
-void update_scroll(void);
-void scroll_add_target(float dx, float dy);
-void scroll_apply_immediate(float dx, float dy);
+#include <stdbool.h>
+
+/* Advance the smooth scroll animation by one frame. Returns true while the
+ * offsets have not reached their targets yet */
+bool update_scroll(void);
+void scroll_add_target(double dx, double dy);
+void scroll_apply_immediate(double dx, double dy);
 void scroll_clamp_all(void);
@@ -0,0 +1,24 @@
+#pragma once
+/* statx_ring.h */
+#include <stdbool.h>
+#include <sys/stat.h>
+
+/* Batched stat through io_uring: a whole directory's worth of IORING_OP_STATX
+ * requests is submitted at once so the device sees a deep queue instead of
+ * one synchronous lstat at a time. */
+typedef struct StatxRing StatxRing;
+
+/* Create a ring with room for `depth` requests in flight.
+ * Returns NULL when io_uring is unavailable (old kernel, seccomp, ...);
+ * callers then stay on plain fstatat(). */
+StatxRing *statx_ring_create(unsigned depth);
+
+void statx_ring_destroy(StatxRing *ring);
+
+/* Stat `count` names relative to `dirfd` with the given AT_* flags.
+ * For every name res[i] is 0 with st[i] filled in, or a negative errno.
+ * Returns false if the ring itself failed; results are then unusable and
+ * the ring refuses further batches. Requests already submitted are waited
+ * for before returning. */
+bool statx_ring_stat(StatxRing *ring, int dirfd, const char *const *names,
+                     int count, int flags, struct stat *st, int *res);
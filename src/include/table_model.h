@@ -1,10 +1,34 @@
 #pragma once
 
 #include "columns.h"
+#include "config.h"
 #include "provider.h"
+#include "row_index.h"
 #include <SDL3/SDL.h>
 #include <SDL3_ttf/SDL_ttf.h>
 
+/* Rows of one table_format_cells() pass with the text of the columns that
+ * format in bulk */
+typedef struct {
+  void *rows[COLUMN_BULK_ROWS];
+  int bulk_count;
+  int bulk_index[TABLE_BULK_COLS]; /* position in the requested columns */
+  char text[TABLE_BULK_COLS][TABLE_BULK_TEXT];
+  size_t offsets[TABLE_BULK_COLS][COLUMN_BULK_ROWS];
+} BulkPass;
+
+/* Width in pixels of len bytes of text, as the table is drawn */
+typedef int (*TableMeasureFn)(void *ctx, const char *text, size_t len);
+
+/* Text widths of one column: how many cells have each width, so the widest
+ * is known in O(1) and shrinks again when the widest rows are deleted */
+typedef struct {
+  unsigned *count; /* cells by width in pixels */
+  int len;         /* entries in count */
+  int max;         /* widest cell, 0 without cells */
+  int header;      /* header width */
+} ColumnWidths;
+
 typedef struct {
   DataProvider *provider;
   ColumnRegistry *columns;
@@ -12,12 +36,35 @@ typedef struct {
   /* Cached column widths */
   int *col_widths;
 
+  /* Width statistics per column, kept while a measure function is set:
+   * each row is measured once when it comes in and once when it goes */
+  TableMeasureFn measure;
+  void *measure_ctx;
+  ColumnWidths *widths;
+
+  /* Rows [0, measured_rows) are counted in the width statistics; the rows
+   * appended after them wait for table_measure_pending() */
+  int64_t measured_rows;
+
+  /* Scratch of the measuring, grown to the most columns measured at once */
+  char *measure_text;
+  size_t *measure_offsets;
+  int measure_cols;
+
+  /* Lines of each row, counted by the same measuring: the row is as tall
+   * as its cell with the most lines */
+  RowIndex *row_lines;
+
   /* Mutex for thread-safe access */
   SDL_Mutex *mutex;
 
   /* Dirty flags */
   bool widths_dirty;
+  unsigned widths_version; /* bumped whenever widths_dirty is set */
   bool structure_dirty;
+
+  /* Scratch of table_format_cells(), used under the mutex */
+  BulkPass bulk;
 } TableModel;
 
 /* Create table with provider and columns */
@@ -26,21 +73,41 @@ TableModel *table_create(DataProvider *provider, ColumnRegistry *cols);
 /* Destroy table */
 void table_destroy(TableModel *table);
 
+/* Format cell text into buf without allocating. The text is always
+ * terminated and truncated to cap - 1 bytes; returns its length */
+size_t table_format_cell(TableModel *table, int64_t row, int col, char *buf,
+                         size_t cap);
+
+/* Format the cells of rows [row_begin, row_end) in columns cols[0..ncols)
+ * (the first ncols columns if cols is NULL) under a single lock. Cells are
+ * written into text row by row, one after another, each terminated;
+ * offsets[(row - row_begin) * ncols + i] gets the start of each cell.
+ * Stops before the first row that does not fit in cap and returns the
+ * number of rows formatted. A cap of ncols * TABLE_CELL_MAX always fits
+ * a row */
+int table_format_cells(TableModel *table, int64_t row_begin, int64_t row_end,
+                       const int *cols, int ncols, char *text, size_t cap,
+                       size_t *offsets);
+
 /* Get rendered cell text (malloc'd, caller must free) */
-char *table_get_cell(TableModel *table, int row, int col);
+char *table_get_cell(TableModel *table, int64_t row, int col);
 
 /* Get raw row data */
-void *table_get_row_data(TableModel *table, int row);
+void *table_get_row_data(TableModel *table, int64_t row);
 
 /* Get total rows */
-int table_get_row_count(TableModel *table);
+int64_t table_get_row_count(TableModel *table);
 
 /* Get total columns */
 int table_get_col_count(TableModel *table);
 
 /* Dynamic row operations */
-bool table_insert_row(TableModel *table, int row, void *data);
-bool table_delete_row(TableModel *table, int row);
+bool table_insert_row(TableModel *table, int64_t row, void *data);
+bool table_delete_row(TableModel *table, int64_t row);
+
+/* Append rows at the end under a single lock. They are not measured
+ * here but by table_measure_pending() */
+bool table_append_rows(TableModel *table, void **rows, int count);
 
 /* Dynamic column operations */
 bool table_add_column(TableModel *table, ColumnDef col);
@@ -50,13 +117,54 @@ bool table_remove_column(TableModel *table, int col_idx);
 /* Get column definition */
 ColumnDef *table_get_column(TableModel *table, int col_idx);
 
-/* Recalculate column widths based on font and padding */
-void table_recalc_widths(TableModel *table, TTF_Font *font, int padding);
+/* Measure cell and header text with fn from now on; the rows already in
+ * the table become pending. fn runs under the table mutex, on the thread
+ * that adds, deletes or measures rows. NULL stops tracking */
+void table_set_measure(TableModel *table, TableMeasureFn fn, void *ctx);
+
+/* Measure up to budget of the rows appended since the last call, so a
+ * large batch is spread over several frames. Returns the rows measured,
+ * 0 once none are pending */
+int64_t table_measure_pending(TableModel *table, int64_t budget);
+
+/* Measure the headers again, after what they show (totals) changed */
+void table_measure_headers(TableModel *table);
+
+/* Widest header or cell text of a column in pixels, 0 without a measure
+ * function. O(1) */
+int table_get_text_width(TableModel *table, int col_idx);
+
+/* Changes whenever a tracked text width, the lines of a row or the column
+ * set changes, so a layout can tell whether it is still current */
+unsigned table_get_widths_version(TableModel *table);
+
+/* Width each column needs, its widest text plus padding on both sides but
+ * at least width_min, for up to cap columns under one lock. Returns how
+ * many were written */
+int table_get_content_widths(TableModel *table, int padding, int *widths,
+                             int cap);
+
+/* Row geometry from the lines of each row: a row of n lines is
+ * n * line_px + row_px high, rows past the last count as one line.
+ * Lines of a row, lines of rows [0, row), and the row pixel y (from the
+ * top of row 0) falls in with the y of its top in *top; O(log n) each */
+int table_get_row_lines(TableModel *table, int64_t row);
+int64_t table_get_lines_before(TableModel *table, int64_t row);
+int64_t table_find_row(TableModel *table, double y, double row_px,
+                       double line_px, double *top);
+
+/* Recalculate column widths from the widest header and cell of each column
+ * plus padding on both sides, within the column's width_min/width_max */
+void table_recalc_widths(TableModel *table, int padding);
 
 /* Get cached column width */
 int table_get_col_width(TableModel *table, int col_idx);
 
-/* Get rendered header text for column */
+/* Format header text into buf, like table_format_cell() */
+size_t table_format_header(TableModel *table, int col_idx, char *buf,
+                           size_t cap);
+
+/* Get rendered header text for column (malloc'd, caller must free) */
 char *table_get_header(TableModel *table, int col_idx);
 
 /* Mark structure/widths as dirty for recalculation */
@@ -0,0 +1,29 @@
+#pragma once
+/* template.h */
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A %-template ("File at %P") compiled into a list of literal spans and
+ * field references, so cells are rendered with memcpy only instead of
+ * parsing the template again for every cell. */
+typedef struct Template Template;
+
+/* Value of `field` for one expansion: returns its text and sets *len.
+ * scratch (cap bytes) may be used to build it. NULL expands to nothing */
+typedef const char *(*TemplateFieldFn)(void *ctx, char field, char *scratch,
+                                       size_t cap, size_t *len);
+
+/* Compile src. `fields` lists the field letters the caller resolves; "%%"
+ * becomes '%' and any other %-sequence is kept as literal text. Returns
+ * NULL for a NULL src or when out of memory */
+Template *template_compile(const char *src, const char *fields);
+
+void template_free(Template *tpl);
+
+/* Expand into buf (always terminated, truncated to cap - 1); returns the
+ * length written. Fields are asked from `field` */
+size_t template_expand(const Template *tpl, char *buf, size_t cap,
+                       TemplateFieldFn field, void *ctx);
+
+/* Whether the template references `field` */
+bool template_uses(const Template *tpl, char field);
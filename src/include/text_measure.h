@@ -0,0 +1,23 @@
+#pragma once
+/* text_measure.h */
+#include <SDL3/SDL.h>
+#include <SDL3_ttf/SDL_ttf.h>
+#include <stddef.h>
+
+/* Text widths of one font without shaping every string. Advances of code
+ * points are looked up once and cached; in a fixed-pitch font runs of
+ * printable ASCII are found 16 bytes at a time and cost their length times
+ * the advance. Only text with code points of scripts that need shaping
+ * (combining marks, Arabic, Indic, Thai, ...) goes to TTF_GetStringSize().
+ * Widths match glyph_atlas_queue_text(): advances plus pair kerning.
+ *
+ * Not thread-safe: the cache is shared, use it from the thread that owns
+ * the font. */
+typedef struct TextMeasure TextMeasure;
+
+/* NULL when out of memory */
+TextMeasure *text_measure_create(TTF_Font *font);
+void text_measure_destroy(TextMeasure *tm);
+
+/* Width in pixels of len bytes of UTF-8 text */
+int text_measure_width(TextMeasure *tm, const char *text, size_t len);
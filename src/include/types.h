@@ -2,6 +2,7 @@
 
 #include <SDL3/SDL.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
   char *text;
@@ -12,11 +13,31 @@ typedef struct {
 typedef struct SizeAlloc {
   bool need_horz;
   bool need_vert;
-  float total_grid_w;
-  float total_grid_h;
+  /* Virtual extent of the grid. Double: a float stops resolving single
+   * pixels past 2^24 (a few hundred thousand rows), a double is exact far
+   * beyond 100M rows */
+  double total_grid_w;
+  double total_grid_h;
   float content_w;
   float content_h;
   int *col_widths;
-  float *col_left;
-  float row_height;
+  double *col_left; /* virtual x of each column, like total_grid_w */
+  int col_count;
+  int col_capacity; /* allocated entries of col_widths/col_left */
+  float row_height;  /* of a row of one line, grid line not included */
+  float line_height; /* added by each further line of a row */
+
+  /* What the layout was computed from; it is only recomputed when one of
+   * these changes */
+  bool valid;
+  int win_w, win_h;
+  int64_t row_count;
+  unsigned widths_version;
 } SizeAlloc;
+
+/* Table state a frame is drawn from. Copied under g_grid_mutex at the start
+ * of the frame; layout, drawing and present then run without the lock */
+typedef struct FrameSnapshot {
+  int64_t row_count; /* data rows, header not included */
+  unsigned long long total_bytes;
+} FrameSnapshot;
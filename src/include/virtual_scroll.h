@@ -2,30 +2,62 @@
 #include "types.h"
 #include <SDL3/SDL.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define VSCROLL_BUFFER_SIZE 500
 #define VSCROLL_PREFETCH 100
+/* Columns cached beyond the visible ones on each side */
+#define VSCROLL_PREFETCH_COLS 16
 
+/* Formatted cells of the rows around the viewport. Rows live in a ring of
+ * VSCROLL_BUFFER_SIZE slots keyed by absolute row (slot = row % size), so
+ * scrolling only formats rows that enter the window and drops rows that
+ * left it; everything else is reused as is. The text of a slot lives in one
+ * buffer owned by the slot, so formatting a row allocates only when it is
+ * longer than anything the slot held before.
+ *
+ * Only a window of columns is cached: the visible ones plus
+ * VSCROLL_PREFETCH_COLS on each side, so the cells of a slot do not grow
+ * with the width of the table. When the visible columns leave the window
+ * it moves: cells of the columns in both windows are kept, and only the
+ * columns that entered it are formatted, appended to the text of the slot.
+ * A slot whose text would have to grow while it still holds text of
+ * columns that left is formatted again from scratch instead. */
 typedef struct {
-  int buffer_start_row;
+  int64_t buffer_start_row; /* window of rows kept cached */
   int buffer_count;
-  Cell **buffer;
-  int desired_start_row;
-  bool needs_reload;
-  int total_virtual_rows;
-
-  SDL_Texture **texture_cache;
-  bool *texture_valid;
+  Cell **buffer;        /* [slot][col - col_begin], text NULL until formatted */
+  size_t **text_at;     /* [slot][col - col_begin] offset in slot_text */
+  int64_t *buffer_rows; /* row held by each slot, -1 if none */
+  char **slot_text; /* [slot] text of the columns, cells point into it */
+  size_t *slot_text_cap;
+  size_t *slot_text_used;
+  bool *slot_text_stale; /* also holds text of columns that left */
+  size_t *slot_offsets;  /* [i] scratch for table_format_cells() */
+  int cols;              /* of the table */
+  int col_begin;         /* window of columns kept cached */
+  int col_count;
+  int col_capacity; /* cells allocated per slot */
+  int *col_index;   /* [i] scratch: table columns being formatted */
+  int64_t desired_start_row;
+  int64_t total_virtual_rows;
 } VirtualScrollState;
 
 VirtualScrollState *vscroll_init(int cols);
 void vscroll_cleanup(VirtualScrollState *vs);
-void vscroll_update_buffer_position(VirtualScrollState *vs, float view_y,
-                                    float content_h, float row_height);
-void vscroll_load_from_grid(VirtualScrollState *vs, int start_row, int count);
-Cell *vscroll_get_cell(VirtualScrollState *vs, int virtual_row, int col);
-SDL_Texture *vscroll_get_cached_texture(VirtualScrollState *vs, int buf_idx,
-                                        int col);
-void vscroll_set_cached_texture(VirtualScrollState *vs, int buf_idx, int col,
-                                SDL_Texture *tex);
-void vscroll_invalidate_all_textures(VirtualScrollState *vs);
+
+/* Move the cached window to the rows of the layout visible at offset_y
+ * plus VSCROLL_PREFETCH rows on both sides, evicting rows that left it,
+ * and the column window to the columns visible at offset_x */
+void vscroll_update_buffer_position(VirtualScrollState *vs,
+                                    const SizeAlloc *sa, double offset_x,
+                                    double offset_y);
+
+/* Cell of a virtual row (0 is the header), formatting the row on a miss;
+ * NULL for a column outside the column window. text_width is -1 until the
+ * caller measures it */
+Cell *vscroll_get_cell(VirtualScrollState *vs, int64_t virtual_row, int col);
+
+/* Drop cached text, e.g. after the header totals or the columns changed */
+void vscroll_invalidate_row(VirtualScrollState *vs, int64_t virtual_row);
+void vscroll_invalidate_all(VirtualScrollState *vs);
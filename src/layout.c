@@ -7,17 +7,66 @@
 #include <math.h>
 #include <stdlib.h>
 
-SizeAlloc sizeAllocate(int win_w, int win_h) {
-  SizeAlloc sa;
-  sa.col_widths = NULL;
-  sa.col_left = NULL;
-  sa.need_horz = false;
-  sa.need_vert = false;
-  sa.total_grid_w = 0.0f;
-  sa.total_grid_h = 0.0f;
-  sa.content_w = 0.0f;
-  sa.content_h = 0.0f;
-  sa.row_height = 0.0f;
+/* Make room for count columns */
+static bool layout_reserve(SizeAlloc *sa, int count) {
+  if (count <= sa->col_capacity)
+    return true;
+
+  int *widths = realloc(sa->col_widths, (size_t)count * sizeof *widths);
+  if (!widths)
+    return false;
+  sa->col_widths = widths;
+
+  double *left = realloc(sa->col_left, (size_t)count * sizeof *left);
+  if (!left)
+    return false;
+  sa->col_left = left;
+
+  sa->col_capacity = count;
+  return true;
+}
+
+void layout_free(SizeAlloc *sa) {
+  free(sa->col_widths);
+  free(sa->col_left);
+  *sa = (SizeAlloc){0};
+}
+
+/* Publish the scalars of the layout for scrolling and hit-testing */
+static void layout_publish(const SizeAlloc *sa) {
+  g_need_horz = sa->need_horz;
+  g_need_vert = sa->need_vert;
+  g_total_grid_w = sa->total_grid_w;
+  g_total_grid_h = sa->total_grid_h;
+  g_content_w = sa->content_w;
+  g_content_h = sa->content_h;
+  g_row_height = sa->row_height;
+}
+
+const SizeAlloc *sizeAllocate(int win_w, int win_h, const FrameSnapshot *snap) {
+  SizeAlloc *sa = &g_layout;
+
+  /* Get column count from table */
+  int col_count = g_table ? table_get_col_count(g_table) : g_cols;
+  int64_t row_count = snap ? snap->row_count : g_rows;
+  unsigned widths_version = g_table ? table_get_widths_version(g_table) : 0;
+
+  /* Nothing the layout depends on changed: keep it */
+  if (sa->valid && sa->win_w == win_w && sa->win_h == win_h &&
+      sa->col_count == col_count && sa->row_count == row_count &&
+      sa->widths_version == widths_version)
+    return sa;
+
+  sa->valid = true;
+  sa->win_w = win_w;
+  sa->win_h = win_h;
+  sa->row_count = row_count;
+  sa->widths_version = widths_version;
+
+  sa->need_horz = false;
+  sa->need_vert = false;
+  sa->total_grid_w = 0.0;
+  sa->total_grid_h = 0.0;
 
 #ifdef WITH_BORDER
   float border = BORDER_WIDTH;
@@ -30,87 +79,67 @@ SizeAlloc sizeAllocate(int win_w, int win_h) {
   float view_w = win_w - 2 * border;
   float view_h = win_h - 2 * border;
 
+  g_view_x = view_x;
+  g_view_y = view_y;
+  g_view_w = view_w;
+  g_view_h = view_h;
+
   int font_height = TTF_GetFontHeight(g_font);
   float min_cell_h = (float)font_height + 2 * CELL_PADDING;
   float line_w = GRID_LINE_WIDTH;
 
-  /* Get column count from table */
-  int col_count = g_table ? table_get_col_count(g_table) : g_cols;
+  sa->content_w = view_w;
+  sa->content_h = view_h;
+  sa->row_height = min_cell_h;
+  sa->line_height = (float)font_height;
 
-  if (col_count == 0) {
-    sa.need_horz = false;
-    sa.need_vert = false;
-    sa.total_grid_w = 0.0f;
-    sa.total_grid_h = 0.0f;
-    sa.content_w = view_w;
-    sa.content_h = view_h;
-    sa.row_height = min_cell_h;
-    sa.col_widths = NULL;
-    sa.col_left = NULL;
+  if (col_count == 0 || !layout_reserve(sa, col_count)) {
+    sa->col_count = 0;
+    layout_publish(sa);
     return sa;
   }
+  sa->col_count = col_count;
 
-  /* Step 1: Get base widths from g_max_col_widths (content-based) */
-  sa.col_widths = malloc((size_t)col_count * sizeof *sa.col_widths);
-  if (!sa.col_widths) {
-    sa.total_grid_w = 0.0f;
-    sa.total_grid_h = 0.0f;
-    sa.content_w = view_w;
-    sa.content_h = view_h;
-    sa.row_height = min_cell_h;
-    sa.col_left = NULL;
-    return sa;
+  /* Step 1: Get base widths from the widest text of each column, at least
+   * width_min, all under one table lock */
+  int known = g_table ? table_get_content_widths(g_table, CELL_PADDING,
+                                                 sa->col_widths, col_count)
+                      : 0;
+  for (int c = known; c < col_count; c++) {
+    sa->col_widths[c] = 100; /* Fallback */
   }
 
   int total_content_width = 0;
   for (int c = 0; c < col_count; c++) {
-    int col_width = 0;
-
-    /* Use g_max_col_widths if available (tracks actual text widths) */
-    if (g_max_col_widths && c < g_cols) {
-      col_width = g_max_col_widths[c] + 2 * CELL_PADDING;
-    } else {
-      col_width = 100; /* Fallback */
-    }
-
-    /* Respect minimum width from config */
-    if (g_table) {
-      ColumnDef *col_def = table_get_column(g_table, c);
-      if (col_def) {
-        col_width = SDL_max(col_width, col_def->width_min);
-      }
-    }
-
-    sa.col_widths[c] = col_width;
-    total_content_width += col_width;
+    total_content_width += sa->col_widths[c];
   }
 
   /* Calculate total width with grid lines */
-  sa.total_grid_w = (float)total_content_width;
+  sa->total_grid_w = (double)total_content_width;
   /* Add grid lines between columns (only if more than 1 column) */
   if (col_count > 1) {
-    sa.total_grid_w += (float)(col_count - 1) * line_w;
+    sa->total_grid_w += (double)(col_count - 1) * line_w;
   }
 
   /* Calculate row height and grid height */
   float row_h = min_cell_h;
-  float total_grid_h = 0.0f;
+  double total_grid_h = 0.0;
 
-  int row_count = g_table ? table_get_row_count(g_table) : g_rows;
   if (row_count > 0) {
-    /* Header row + data rows */
-    int total_rows = row_count + 1;
-    total_grid_h = (float)total_rows * row_h;
+    /* Header row + data rows, each as high as its lines */
+    int64_t total_rows = row_count + 1;
+    int64_t extra_lines =
+        g_table ? table_get_lines_before(g_table, row_count) - row_count : 0;
+    total_grid_h = (double)total_rows * row_h +
+                   (double)extra_lines * sa->line_height;
     /* Add grid lines between rows */
     if (total_rows > 1) {
-      total_grid_h += (float)(total_rows - 1) * line_w;
+      total_grid_h += (double)(total_rows - 1) * line_w;
     }
   }
 
-  sa.row_height = row_h;
-
   /* Detect if we need scrollbars - initial pass */
-  bool need_horz = sa.total_grid_w > view_w;
+  bool need_horz = sa->total_grid_w > view_w;
   bool need_vert = total_grid_h > view_h;
 
   /* Account for scrollbar taking space */
@@ -118,54 +147,117 @@ SizeAlloc sizeAllocate(int win_w, int win_h) {
   float available_h = view_h - (need_horz ? SCROLLBAR_WIDTH : 0.0f);
 
   /* Step 2: Calculate buffer zone (available space minus content) */
-  float buffer_zone = available_w - sa.total_grid_w;
+  float buffer_zone = available_w - (float)sa->total_grid_w;
 
   /* Step 3: Distribute buffer zone equally among columns */
   if (buffer_zone > 0 && col_count > 0) {
     float per_column = buffer_zone / (float)col_count;
 
     for (int c = 0; c < col_count; c++) {
-      sa.col_widths[c] = (int)((float)sa.col_widths[c] + per_column);
+      sa->col_widths[c] = (int)((float)sa->col_widths[c] + per_column);
     }
 
-    sa.total_grid_w = available_w;
+    sa->total_grid_w = available_w;
   }
 
   /* Recalculate scrollbar needs with final widths */
-  need_horz = sa.total_grid_w > available_w;
+  need_horz = sa->total_grid_w > available_w;
   need_vert = total_grid_h > available_h;
 
-  sa.content_w = view_w - (need_vert ? SCROLLBAR_WIDTH : 0.0f);
-  sa.content_h = view_h - (need_horz ? SCROLLBAR_WIDTH : 0.0f);
+  sa->content_w = view_w - (need_vert ? SCROLLBAR_WIDTH : 0.0f);
+  sa->content_h = view_h - (need_horz ? SCROLLBAR_WIDTH : 0.0f);
 
-  sa.need_horz = need_horz;
-  sa.need_vert = need_vert;
-  sa.total_grid_h = total_grid_h;
+  sa->need_horz = need_horz;
+  sa->need_vert = need_vert;
+  sa->total_grid_h = total_grid_h;
 
   /* Calculate column positions */
-  sa.col_left = malloc((size_t)col_count * sizeof *sa.col_left);
-  if (col_count > 0) {
-    sa.col_left[0] = 0.0f;
-  }
+  sa->col_left[0] = 0.0;
   for (int c = 1; c < col_count; c++) {
-    sa.col_left[c] = sa.col_left[c - 1] + (float)sa.col_widths[c - 1];
-    if (c > 0) {
-      sa.col_left[c] += line_w; /* Add line width before this column */
-    }
+    /* Add line width before this column */
+    sa->col_left[c] = sa->col_left[c - 1] + (double)sa->col_widths[c - 1] +
+                      (double)line_w;
   }
 
-  g_view_x = view_x;
-  g_view_y = view_y;
-  g_view_w = view_w;
-  g_view_h = view_h;
+  layout_publish(sa);
+  return sa;
+}
 
-  /* Detect resize for virtual scroll */
-  if (fabsf(sa.content_h - g_last_content_h) > 1.0f) {
-    if (g_vscroll) {
-      g_vscroll->needs_reload = true;
-    }
-    g_last_content_h = sa.content_h;
+/* Row at y when every row is one line, without a table */
+static int64_t uniform_row_at(const SizeAlloc *sa, double y, double *top_out) {
+  double row_full = (double)sa->row_height + GRID_LINE_WIDTH;
+  int64_t row = (int64_t)floor(y / row_full);
+  double top = (double)row * row_full;
+
+  /* The rounded quotient can be one row off right at a row boundary */
+  if (top > y) {
+    row--;
+    top -= row_full;
+  } else if (top + row_full <= y) {
+    row++;
+    top += row_full;
   }
+  *top_out = top;
+  return row;
+}
 
-  return sa;
-}
\ No newline at end of file
+/* Data rows are looked up in the row index of the table */
+int64_t layout_row_at(const SizeAlloc *sa, double y, double *within) {
+  double header = (double)sa->row_height + GRID_LINE_WIDTH;
+  double top;
+  int64_t row;
+
+  if (!g_table) {
+    row = uniform_row_at(sa, y, &top);
+  } else if (y < header) {
+    row = 0;
+    top = 0.0;
+  } else {
+    /* A data row of n lines: n line heights plus padding and grid line */
+    double row_px = header - sa->line_height;
+    row = 1 + table_find_row(g_table, y - header, row_px, sa->line_height,
+                             &top);
+    top += header;
+  }
+  if (within)
+    *within = y - top;
+  return row;
+}
+
+double layout_row_top(const SizeAlloc *sa, int64_t row) {
+  double row_full = (double)sa->row_height + GRID_LINE_WIDTH;
+  if (!g_table || row <= 0)
+    return (double)row * row_full;
+
+  /* Header and data rows above, plus the lines beyond the first of each */
+  int64_t lines = table_get_lines_before(g_table, row - 1);
+  return (double)row * row_full +
+         (double)(lines - (row - 1)) * sa->line_height;
+}
+
+int layout_row_lines(const SizeAlloc *sa, int64_t row) {
+  (void)sa;
+  if (!g_table || row <= 0)
+    return 1;
+  return table_get_row_lines(g_table, row - 1);
+}
+
+float layout_row_height(const SizeAlloc *sa, int64_t row) {
+  return sa->row_height +
+         (float)(layout_row_lines(sa, row) - 1) * sa->line_height;
+}
+
+int layout_col_at(const SizeAlloc *sa, double x) {
+  if (sa->col_count == 0)
+    return -1;
+
+  int lo = 0, hi = sa->col_count - 1;
+  while (lo < hi) {
+    int mid = lo + (hi - lo + 1) / 2;
+    if (sa->col_left[mid] <= x)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
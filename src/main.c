@@ -5,6 +5,7 @@
 #include "include/fs.h"
 #include "include/globals.h"
 #include "include/grid.h"
+#include "include/headless.h"
 #include "include/layout.h"
 #include "include/provider.h"
 #include "include/scroll.h"
@@ -19,7 +20,57 @@
 #include <string.h>
 #include <unistd.h>
 
+/* Width of text in g_font, for the width statistics of the table */
+static int measure_text(void *ctx, const char *text, size_t len) {
+  return text_measure_width(ctx, text, len);
+}
+
+/* Lay out and draw one frame from a snapshot; runs without g_grid_mutex.
+ * Returns true while a scroll animation still needs more frames */
+static bool draw_frame(int win_w, int win_h, const FrameSnapshot *snap) {
+  /* Kept from the previous frame unless its inputs changed; column widths
+   * come from the width statistics of the table */
+  const SizeAlloc *sa = sizeAllocate(win_w, win_h, snap);
+
+  /* Clamp scroll offsets to valid range after layout recalculation */
+  scroll_clamp_all();
+
+  /* Update virtual scroll with actual table row count */
+  int64_t total_display_rows = snap->row_count + 1; /* +1 for header */
+
+  if (g_vscroll->total_virtual_rows != total_display_rows) {
+    g_vscroll->total_virtual_rows = total_display_rows;
+  }
+
+  /* g_rows is only buffer size, not total rows */
+  g_rows = VSCROLL_BUFFER_SIZE + 1;
+
+  vscroll_update_buffer_position(g_vscroll, sa, g_offset_x, g_offset_y);
+
+  bool animating = update_scroll();
+
+  draw_with_alloc(sa, snap);
+
+  return animating;
+}
+
 int main(int argc, char *argv[]) {
+  /* --format selects the headless listing; it is taken out of argv so the
+   * directory argument is handled the same way in both modes */
+  bool headless = false;
+  HeadlessFormat format = HEADLESS_TSV;
+  if (argc >= 3 && strcmp(argv[1], "--format") == 0) {
+    if (!headless_parse_format(argv[2], &format)) {
+      fprintf(stderr, "Unknown format '%s', expected tsv, csv or ndjson\n",
+              argv[2]);
+      return 1;
+    }
+    headless = true;
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
   char *dir_path = NULL;
   if (argc == 2) {
     dir_path = argv[1];
@@ -31,7 +82,8 @@ int main(int argc, char *argv[]) {
       return 1;
     }
   } else {
-    fprintf(stderr, "Usage: %s [directory]\n", argv[0]);
+    fprintf(stderr, "Usage: %s [--format tsv|csv|ndjson] [directory]\n",
+            argv[0]);
     return 1;
   }
 
@@ -39,10 +91,18 @@ int main(int argc, char *argv[]) {
   if (!loc) {
     fprintf(stderr,
             "Warning: setlocale(LC_ALL, \"\") failed — using \"C\" locale\n");
-  } else {
+  } else if (!headless) {
     fprintf(stderr, "Locale set to: %s\n", loc);
   }
 
+  /* No SDL, font or window: only traversal and the column renderers */
+  if (headless) {
+    int status = headless_run(dir_path, format);
+    if (argc == 1)
+      free(dir_path);
+    return status;
+  }
+
   init_fs_log();
 
   atexit(cleanup);
@@ -82,6 +142,14 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  g_measure = text_measure_create(g_font);
+  if (!g_measure) {
+    fprintf(stderr, "Failed to create text measurement\n");
+    if (argc == 1)
+      free(dir_path);
+    return 1;
+  }
+
   g_grid_mutex = SDL_CreateMutex();
   if (!g_grid_mutex) {
     fprintf(stderr, "Failed to create mutex: %s\n", SDL_GetError());
@@ -108,10 +176,17 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  cols_add(cols, col_path_default());
-  cols_add(cols, col_size_default());
-  cols_add(cols, col_date_default());
-  cols_add(cols, col_perms_default());
+  if (!cols_add(cols, col_path_default()) ||
+      !cols_add(cols, col_size_default()) ||
+      !cols_add(cols, col_date_default()) ||
+      !cols_add(cols, col_perms_default())) {
+    fprintf(stderr, "Failed to add columns\n");
+    cols_destroy(cols);
+    provider_destroy(provider);
+    if (argc == 1)
+      free(dir_path);
+    return 1;
+  }
 
   g_table = table_create(provider, cols);
   if (!g_table) {
@@ -150,23 +225,6 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  g_max_col_widths = calloc((size_t)g_cols, sizeof *g_max_col_widths);
-  if (!g_max_col_widths) {
-    fprintf(stderr, "Failed to allocate memory for max_col_widths\n");
-    if (argc == 1)
-      free(dir_path);
-    return 1;
-  }
-
-  /* Initialize headers from table */
-  for (int c = 0; c < g_cols; c++) {
-    char *header = table_get_header(g_table, c);
-    if (header) {
-      set_cell(0, c, header);
-      free(header);
-    }
-  }
-
   g_vscroll = vscroll_init(g_cols);
   if (!g_vscroll) {
     fprintf(stderr, "Failed to initialize virtual scrolling\n");
@@ -204,10 +262,19 @@ int main(int argc, char *argv[]) {
 
   fprintf(stderr, "Window created\n");
 
+  ANY_CHECK(g_atlas = glyph_atlas_create(g_renderer, g_font, TEXT_FONT_COLOUR,
+                                         GRID_BACKGROUND_COLOUR),
+            "Glyph atlas creation failed");
+
+  /* Every row is measured once, a slice per frame after it was drained */
+  table_set_measure(g_table, measure_text, g_measure);
+
   g_scroll_target_x = g_offset_x;
   g_scroll_target_y = g_offset_y;
 
   bool running = true;
+  bool redraw = true;
+  bool animating = false;
 
   SDL_Event event;
   const int frame_delay_ms = 16;
@@ -216,157 +283,75 @@ int main(int argc, char *argv[]) {
   fprintf(stderr, "Entering main loop\n");
 
   while (running) {
-    int win_w_local = 0, win_h_local = 0;
-    SDL_GetWindowSize(g_window, &win_w_local, &win_h_local);
-
-    if (!g_vscroll || !g_table) {
-      SDL_UnlockMutex(g_grid_mutex);
+    if (!g_vscroll || !g_table)
       break;
-    }
-
-    SDL_LockMutex(g_grid_mutex);
-
-    /* Update headers if any totals changed */
-    if (g_total_bytes != last_total_bytes) {
-      if (g_grid && g_grid[0]) {
-        for (int c = 0; c < g_cols; ++c) {
-          char *header = table_get_header(g_table, c);
-          if (header) {
-            set_cell_with_width_update(0, c, header);
-            free(header);
-          }
-        }
-      }
-      last_total_bytes = g_total_bytes;
-      table_mark_dirty(g_table, true, false); /* Mark widths dirty */
-    }
-
-    /* Reset g_max_col_widths before recalculating */
-    if (g_max_col_widths) {
-      for (int c = 0; c < g_cols; c++) {
-        g_max_col_widths[c] = 0;
-      }
-    }
-
-    /* Recalculate g_max_col_widths from actual table content */
-    int table_rows = table_get_row_count(g_table);
-
-    /* Check header row */
-    for (int c = 0; c < g_cols; c++) {
-      char *header = table_get_header(g_table, c);
-      if (header) {
-        int w, h;
-        size_t len = strlen(header);
-        if (TTF_GetStringSize(g_font, header, len, &w, &h)) {
-          if (g_max_col_widths) {
-            g_max_col_widths[c] = SDL_max(g_max_col_widths[c], w);
-          }
-        }
-        free(header);
-      }
-    }
-
-    /* Sample first 100 data rows */
-    int sample_size = SDL_min(100, table_rows);
-    for (int r = 0; r < sample_size; r++) {
-      for (int c = 0; c < g_cols; c++) {
-        char *cell = table_get_cell(g_table, r, c);
-        if (cell) {
-          int w, h;
-          size_t len = strlen(cell);
-          if (TTF_GetStringSize(g_font, cell, len, &w, &h)) {
-            if (g_max_col_widths) {
-              g_max_col_widths[c] = SDL_max(g_max_col_widths[c], w);
-            }
-          }
-          free(cell);
-        }
-      }
-    }
 
-    /* IMPORTANT: sizeAllocate AFTER calculating max widths */
-    SizeAlloc sa = sizeAllocate(win_w_local, win_h_local);
+    /* Read before draining: once traversal is seen finished, the drain below
+     * picks up its last rows */
+    bool traversing = g_fs_traversing;
 
-    /* Clamp scroll offsets to valid range after layout recalculation */
-    scroll_clamp_all();
-
-    /* Update virtual scroll with actual table row count */
-    table_rows = table_get_row_count(g_table);
-    int total_display_rows = table_rows + 1; /* +1 for header */
-
-    if (g_vscroll->total_virtual_rows != total_display_rows) {
-      g_vscroll->total_virtual_rows = total_display_rows;
-    }
-
-    /* g_rows is only buffer size, not total rows */
-    g_rows = VSCROLL_BUFFER_SIZE + 1;
-
-    vscroll_update_buffer_position(g_vscroll, g_view_y, g_content_h,
-                                   sa.row_height);
+    SDL_LockMutex(g_grid_mutex);
 
-    if (g_vscroll && g_vscroll->needs_reload) {
-      g_vscroll->needs_reload = false;
-      g_vscroll->buffer_start_row = g_vscroll->desired_start_row;
-      g_vscroll->buffer_count = VSCROLL_BUFFER_SIZE;
+    /* Pick up rows published by traversal since the last frame */
+    if (fs_drain(g_table) > 0)
+      redraw = true;
+
+    /* Everything the frame needs from shared state, under a short lock */
+    FsTotals totals = fs_get_totals();
+    FrameSnapshot snap = {
+        .row_count = table_get_row_count(g_table),
+        .total_bytes = totals.bytes,
+    };
+
+    /* Headers show the totals: measure them again and drop the cached
+     * header row, it is formatted again when drawn */
+    if (snap.total_bytes != last_total_bytes) {
+      last_total_bytes = snap.total_bytes;
+      table_measure_headers(g_table);
+      vscroll_invalidate_row(g_vscroll, 0);   /* header shows the totals */
+      redraw = true;
     }
 
-    g_need_horz = sa.need_horz;
-    g_need_vert = sa.need_vert;
-    g_total_grid_w = sa.total_grid_w;
-    g_total_grid_h = sa.total_grid_h;
-    g_content_w = sa.content_w;
-    g_content_h = sa.content_h;
-
-    g_row_height = sa.row_height;
+    SDL_UnlockMutex(g_grid_mutex);
 
-    if (g_col_left) {
-      free(g_col_left);
-      g_col_left = NULL;
-    }
-    if (g_col_widths) {
-      free(g_col_widths);
-      g_col_widths = NULL;
+    /* Widths of the rows drained so far, a bounded slice per frame */
+    bool measuring = table_measure_pending(g_table, TABLE_MEASURE_BUDGET) > 0;
+    if (measuring)
+      redraw = true;
+
+    /* Layout, text and present (which may wait for vsync) run unlocked */
+    if (redraw || animating) {
+      int win_w_local = 0, win_h_local = 0;
+      SDL_GetWindowSize(g_window, &win_w_local, &win_h_local);
+      animating = draw_frame(win_w_local, win_h_local, &snap);
+      redraw = false;
     }
 
-    if (g_cols > 0) {
-      g_col_left = malloc((size_t)g_cols * sizeof *g_col_left);
-      g_col_widths = malloc((size_t)g_cols * sizeof *g_col_widths);
-      if (g_col_left && g_col_widths) {
-        for (int c = 0; c < g_cols; c++) {
-          g_col_left[c] = sa.col_left[c];
-          g_col_widths[c] = sa.col_widths[c];
-        }
-      } else {
-        if (g_col_left) {
-          free(g_col_left);
-          g_col_left = NULL;
+    /* Sleep until input arrives. A scroll animation, a running traversal or
+     * rows still to measure wake the loop once per frame; an idle table does
+     * not wake it at all */
+    int timeout_ms = animating || traversing || measuring ? frame_delay_ms : -1;
+    if (SDL_WaitEventTimeout(&event, timeout_ms)) {
+      int win_w_local = 0, win_h_local = 0;
+      SDL_GetWindowSize(g_window, &win_w_local, &win_h_local);
+
+      SDL_LockMutex(g_grid_mutex);
+      do {
+        if (handle_events(&event, win_w_local, win_h_local)) {
+          running = false;
         }
-        if (g_col_widths) {
-          free(g_col_widths);
-          g_col_widths = NULL;
-        }
-      }
-    }
+      } while (SDL_PollEvent(&event));
+      SDL_UnlockMutex(g_grid_mutex);
 
-    while (SDL_PollEvent(&event)) {
-      if (handle_events(&event, win_w_local, win_h_local)) {
-        running = false;
-      }
+      redraw = true;
     }
-
-    update_scroll();
-
-    draw_with_alloc(&sa);
-
-    free(sa.col_widths);
-    free(sa.col_left);
-    SDL_UnlockMutex(g_grid_mutex);
-
-    SDL_Delay(frame_delay_ms);
   }
 
   fprintf(stderr, "Exiting main loop\n");
   g_stop = true;
   SDL_WaitThread(fs_thread, NULL);
+
+  /* Hand over what was still queued so it is freed with the table */
+  fs_drain(g_table);
   return 0;
 }
\ No newline at end of file
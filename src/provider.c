@@ -1,6 +1,10 @@
 #include "include/provider.h"
+#include "include/arena.h"
+#include "include/cell_format.h"
 #include "include/config.h"
+#include "include/date_format.h"
 #include "include/fileentry.h"
+#include "include/fs.h"
 #include <SDL3/SDL.h>
 #include <dirent.h>
 #include <limits.h>
@@ -14,78 +18,121 @@
 
 typedef struct {
   FileEntry **entries;
-  int count;
-  int capacity;
+  int64_t count;
+  int64_t capacity;
   char *root_path;
+
+  /* Entries and their strings. One arena per traversal worker, so workers
+   * allocate without locking, plus one for strings made while rendering */
+  Arena arenas[FS_MAX_WORKERS];
+  Arena render_arena;
+
+  DateFormat *date_fmt; /* DATE_FORMAT_TEMPLATE */
 } FSProviderCtx;
 
-static int fs_row_count(void *provider_ctx) {
+static int64_t fs_row_count(void *provider_ctx) {
   FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
   return ctx ? ctx->count : 0;
 }
 
-static char *fs_get_cell(void *provider_ctx, int row, int col) {
+/* snprintf result as the length actually written into buf */
+static size_t written(int n, size_t cap) {
+  if (n < 0 || cap == 0)
+    return 0;
+  return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+static size_t fs_format_cell(void *provider_ctx, int64_t row, int col,
+                             char *buf, size_t cap) {
   FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
 
+  if (cap == 0)
+    return 0;
+  buf[0] = '\0';
   if (!ctx || row < -1 || row >= ctx->count || col < 0 || col > 3)
-    return strdup("");
+    return 0;
 
   if (row == -1) {
     /* Header row */
     const char *headers[] = {HEADER_TEMPLATE_0, HEADER_TEMPLATE_1,
                              HEADER_TEMPLATE_2, HEADER_TEMPLATE_3};
-    if (col < 4)
-      return strdup(headers[col]);
-    return strdup("");
+    return written(snprintf(buf, cap, "%s", headers[col]), cap);
   }
 
   FileEntry *entry = ctx->entries[row];
   if (!entry)
-    return strdup("");
+    return 0;
 
   switch (col) {
   case 0: /* Path */
-    return strdup(entry->name ? entry->name : "");
-  case 1: /* Size */
   {
-    char buf[64];
-    snprintf(buf, sizeof buf, "%lld", (long long)entry->st.st_size);
-    return strdup(buf);
+    char name[PATH_MAX];
+    return written(snprintf(buf, cap, "%s",
+                            fs_entry_display_name(entry, name, sizeof name)),
+                   cap);
   }
-  case 2: /* Date */
+  case 1: /* Size */
   {
-    char buf[128];
-    struct tm tm_buf;
-    const char *fmt = DATE_FORMAT_TEMPLATE;
-    if (localtime_r(&entry->st.st_mtime, &tm_buf)) {
-      strftime(buf, sizeof buf, fmt, &tm_buf);
-    } else {
-      strcpy(buf, "???");
-    }
-    return strdup(buf);
+    char text[CELL_FORMAT_SIZE_MAX];
+    fs_entry_ensure_stat(entry);
+    cell_format_size((long long)entry->size, false, text);
+    return written(snprintf(buf, cap, "%s", text), cap);
   }
+  case 2: /* Date */
+    fs_entry_ensure_stat(entry);
+    return date_format(ctx->date_fmt, entry->mtime, buf, cap);
   case 3: /* Permissions */
   {
-    mode_t m = entry->st.st_mode;
-    char buf[64];
-    snprintf(buf, sizeof buf, "%c%c%c%c%c%c%c%c%c%c",
-             S_ISDIR(m)   ? 'd'
-             : S_ISLNK(m) ? 'l'
-             : S_ISREG(m) ? '-'
-                          : '?',
-             (m & S_IRUSR) ? 'r' : '-', (m & S_IWUSR) ? 'w' : '-',
-             (m & S_IXUSR) ? 'x' : '-', (m & S_IRGRP) ? 'r' : '-',
-             (m & S_IWGRP) ? 'w' : '-', (m & S_IXGRP) ? 'x' : '-',
-             (m & S_IROTH) ? 'r' : '-', (m & S_IWOTH) ? 'w' : '-',
-             (m & S_IXOTH) ? 'x' : '-');
-    return strdup(buf);
+    char text[11];
+    fs_entry_ensure_stat(entry);
+    cell_format_mode_ls(entry->mode, text);
+    return written(snprintf(buf, cap, "%s", text), cap);
   }
   }
 
-  return strdup("");
+  return 0;
 }
 
-static void *fs_get_row_data(void *provider_ctx, int row) {
+static int fs_format_cells(void *provider_ctx, int64_t row_begin,
+                           int64_t row_end, const int *cols, int ncols,
+                           char *text, size_t cap, size_t *offsets) {
+  FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
+  if (!ctx || row_begin < 0 || ncols <= 0)
+    return 0;
+  row_end = SDL_min(row_end, ctx->count);
+
+  size_t used = 0;
+  int64_t row = row_begin;
+  for (; row < row_end; row++) {
+    for (int i = 0; i < ncols; i++) {
+      int col = cols ? cols[i] : i;
+      size_t len;
+      if (cap - used >= TABLE_CELL_MAX) {
+        len = fs_format_cell(ctx, row, col, text + used, TABLE_CELL_MAX);
+      } else {
+        /* Format aside: strftime leaves nothing when it does not fit */
+        char cell[TABLE_CELL_MAX];
+        len = fs_format_cell(ctx, row, col, cell, sizeof cell);
+        if (len >= cap - used) {
+          /* Leave the row for the next call */
+          return (int)(row - row_begin);
+        }
+        memcpy(text + used, cell, len + 1);
+      }
+      offsets[(size_t)(row - row_begin) * ncols + i] = used;
+      used += len + 1;
+    }
+  }
+  return (int)(row - row_begin);
+}
+
+static char *fs_get_cell(void *provider_ctx, int64_t row, int col) {
+  char buf[PATH_MAX * 2];
+  fs_format_cell(provider_ctx, row, col, buf, sizeof buf);
+  return strdup(buf);
+}
+
+static void *fs_get_row_data(void *provider_ctx, int64_t row) {
   FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
 
   if (!ctx || row < 0 || row >= ctx->count)
@@ -94,14 +141,14 @@ static void *fs_get_row_data(void *provider_ctx, int row) {
   return (void *)ctx->entries[row];
 }
 
-static bool fs_insert_row(void *provider_ctx, int row, void *data) {
+static bool fs_insert_row(void *provider_ctx, int64_t row, void *data) {
   FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
 
   if (!ctx || row < 0 || row > ctx->count)
     return false;
 
   if (ctx->count >= ctx->capacity) {
-    int new_cap = ctx->capacity == 0 ? 16 : ctx->capacity * 2;
+    int64_t new_cap = ctx->capacity == 0 ? 16 : ctx->capacity * 2;
     FileEntry **new_entries =
         realloc(ctx->entries, (size_t)new_cap * sizeof *new_entries);
     if (!new_entries)
@@ -111,7 +158,7 @@ static bool fs_insert_row(void *provider_ctx, int row, void *data) {
   }
 
   /* Shift entries to the right */
-  for (int i = ctx->count; i > row; i--) {
+  for (int64_t i = ctx->count; i > row; i--) {
     ctx->entries[i] = ctx->entries[i - 1];
   }
 
@@ -121,14 +168,38 @@ static bool fs_insert_row(void *provider_ctx, int row, void *data) {
   return true;
 }
 
-static bool fs_delete_row(void *provider_ctx, int row) {
+static bool fs_append_rows(void *provider_ctx, void **data, int count) {
+  FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
+
+  if (!ctx || !data || count < 0)
+    return false;
+
+  if (ctx->count + count > ctx->capacity) {
+    int64_t new_cap = ctx->capacity == 0 ? 16 : ctx->capacity;
+    while (new_cap < ctx->count + count)
+      new_cap *= 2;
+    FileEntry **new_entries =
+        realloc(ctx->entries, (size_t)new_cap * sizeof *new_entries);
+    if (!new_entries)
+      return false;
+    ctx->entries = new_entries;
+    ctx->capacity = new_cap;
+  }
+
+  memcpy(ctx->entries + ctx->count, data, (size_t)count * sizeof *data);
+  ctx->count += count;
+
+  return true;
+}
+
+static bool fs_delete_row(void *provider_ctx, int64_t row) {
   FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
 
   if (!ctx || row < 0 || row >= ctx->count)
     return false;
 
   /* Shift entries to the left */
-  for (int i = row; i < ctx->count - 1; i++) {
+  for (int64_t i = row; i < ctx->count - 1; i++) {
     ctx->entries[i] = ctx->entries[i + 1];
   }
 
@@ -136,23 +207,22 @@ static bool fs_delete_row(void *provider_ctx, int row) {
   return true;
 }
 
+/* Drop all rows; entries are released with their arenas, chunk by chunk */
+static void fs_release_rows(FSProviderCtx *ctx) {
+  ctx->count = 0;
+  for (int i = 0; i < FS_MAX_WORKERS; i++)
+    arena_free(&ctx->arenas[i]);
+  arena_free(&ctx->render_arena);
+}
+
 static void fs_destroy(void *provider_ctx) {
   FSProviderCtx *ctx = (FSProviderCtx *)provider_ctx;
 
   if (!ctx)
     return;
 
-  for (int i = 0; i < ctx->count; i++) {
-    if (ctx->entries[i]) {
-      free(ctx->entries[i]->name);
-      free(ctx->entries[i]->full_path);
-      free(ctx->entries[i]->resolved_path);
-      free(ctx->entries[i]->dir_path);
-      free(ctx->entries[i]->root_path);
-      free(ctx->entries[i]);
-    }
-  }
-
+  fs_release_rows(ctx);
+  date_format_free(ctx->date_fmt);
   free(ctx->entries);
   free(ctx->root_path);
   free(ctx);
@@ -173,11 +243,16 @@ DataProvider *provider_create_filesystem(const char *path) {
   }
 
   ctx->root_path = strdup(path);
+  ctx->date_fmt = date_format_create(DATE_FORMAT_TEMPLATE);
   ctx->entries = malloc(16 * sizeof *ctx->entries);
   ctx->capacity = 16;
   ctx->count = 0;
+  for (int i = 0; i < FS_MAX_WORKERS; i++)
+    arena_init(&ctx->arenas[i], FS_ARENA_CHUNK_SIZE);
+  arena_init(&ctx->render_arena, FS_ARENA_CHUNK_SIZE);
 
-  if (!ctx->entries || !ctx->root_path) {
+  if (!ctx->entries || !ctx->root_path || !ctx->date_fmt) {
+    date_format_free(ctx->date_fmt);
     free(ctx->entries);
     free(ctx->root_path);
     free(ctx);
@@ -187,8 +262,11 @@ DataProvider *provider_create_filesystem(const char *path) {
 
   provider->ops.row_count = fs_row_count;
   provider->ops.get_cell = fs_get_cell;
+  provider->ops.format_cell = fs_format_cell;
+  provider->ops.format_cells = fs_format_cells;
   provider->ops.get_row_data = fs_get_row_data;
   provider->ops.insert_row = fs_insert_row;
+  provider->ops.append_rows = fs_append_rows;
   provider->ops.delete_row = fs_delete_row;
   provider->ops.destroy = fs_destroy;
   provider->ctx = ctx;
@@ -196,6 +274,19 @@ DataProvider *provider_create_filesystem(const char *path) {
   return provider;
 }
 
+Arena *provider_fs_arena(DataProvider *p, int worker) {
+  if (!p || p->ops.destroy != fs_destroy || worker < 0 ||
+      worker >= FS_MAX_WORKERS)
+    return NULL;
+  return &((FSProviderCtx *)p->ctx)->arenas[worker];
+}
+
+Arena *provider_fs_render_arena(DataProvider *p) {
+  if (!p || p->ops.destroy != fs_destroy)
+    return NULL;
+  return &((FSProviderCtx *)p->ctx)->render_arena;
+}
+
 /* --- Dual-pane Provider --- */
 
 typedef struct {
@@ -203,19 +294,19 @@ typedef struct {
   DataProvider *right;
 } DualProviderCtx;
 
-static int dual_row_count(void *provider_ctx) {
+static int64_t dual_row_count(void *provider_ctx) {
   DualProviderCtx *ctx = (DualProviderCtx *)provider_ctx;
 
   if (!ctx || !ctx->left || !ctx->right)
     return 0;
 
-  int left_count = ctx->left->ops.row_count(ctx->left->ctx);
-  int right_count = ctx->right->ops.row_count(ctx->right->ctx);
+  int64_t left_count = ctx->left->ops.row_count(ctx->left->ctx);
+  int64_t right_count = ctx->right->ops.row_count(ctx->right->ctx);
 
   return SDL_max(left_count, right_count);
 }
 
-static char *dual_get_cell(void *provider_ctx, int row, int col) {
+static char *dual_get_cell(void *provider_ctx, int64_t row, int col) {
   DualProviderCtx *ctx = (DualProviderCtx *)provider_ctx;
 
   if (!ctx || !ctx->left || !ctx->right)
@@ -234,21 +325,42 @@ static char *dual_get_cell(void *provider_ctx, int row, int col) {
   return provider->ops.get_cell(provider->ctx, row, provider_col);
 }
 
-static void *dual_get_row_data(void *provider_ctx, int row) {
+static size_t dual_format_cell(void *provider_ctx, int64_t row, int col,
+                               char *buf, size_t cap) {
+  DualProviderCtx *ctx = (DualProviderCtx *)provider_ctx;
+
+  if (cap == 0)
+    return 0;
+  buf[0] = '\0';
+  if (!ctx || !ctx->left || !ctx->right)
+    return 0;
+
+  /* Same column mapping as dual_get_cell */
+  DataProvider *provider = col % 2 == 0 ? ctx->left : ctx->right;
+  if (provider->ops.format_cell)
+    return provider->ops.format_cell(provider->ctx, row, col / 2, buf, cap);
+
+  char *text = provider->ops.get_cell(provider->ctx, row, col / 2);
+  size_t len = written(snprintf(buf, cap, "%s", text ? text : ""), cap);
+  free(text);
+  return len;
+}
+
+static void *dual_get_row_data(void *provider_ctx, int64_t row) {
   /* Return combined structure or NULL */
   (void)provider_ctx;
   (void)row;
   return NULL;
 }
 
-static bool dual_insert_row(void *provider_ctx, int row, void *data) {
+static bool dual_insert_row(void *provider_ctx, int64_t row, void *data) {
   (void)provider_ctx;
   (void)row;
   (void)data;
   return false; /* Not supported for dual provider */
 }
 
-static bool dual_delete_row(void *provider_ctx, int row) {
+static bool dual_delete_row(void *provider_ctx, int64_t row) {
   (void)provider_ctx;
   (void)row;
   return false; /* Not supported for dual provider */
@@ -287,8 +399,11 @@ DataProvider *provider_create_dual(DataProvider *left, DataProvider *right) {
 
   provider->ops.row_count = dual_row_count;
   provider->ops.get_cell = dual_get_cell;
+  provider->ops.format_cell = dual_format_cell;
+  provider->ops.format_cells = NULL;
   provider->ops.get_row_data = dual_get_row_data;
   provider->ops.insert_row = dual_insert_row;
+  provider->ops.append_rows = NULL;
   provider->ops.delete_row = dual_delete_row;
   provider->ops.destroy = dual_destroy;
   provider->ctx = ctx;
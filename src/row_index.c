@@ -0,0 +1,210 @@
+/* src/row_index.c */
+#include "include/row_index.h"
+#include "include/config.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct RowIndex {
+  unsigned char *lines; /* [row] lines of each row, 0 past the last one */
+  int64_t count;
+  int64_t capacity; /* rows allocated, a multiple of ROW_INDEX_BLOCK */
+  int64_t *tree;    /* Fenwick tree over the lines of each block, 1-based */
+  int64_t blocks;   /* capacity / ROW_INDEX_BLOCK */
+  int64_t total;    /* lines of all rows */
+};
+
+RowIndex *row_index_create(void) { return calloc(1, sizeof(RowIndex)); }
+
+void row_index_destroy(RowIndex *ri) {
+  if (!ri)
+    return;
+  free(ri->lines);
+  free(ri->tree);
+  free(ri);
+}
+
+static void tree_add(RowIndex *ri, int64_t block, int64_t delta) {
+  for (int64_t i = block + 1; i <= ri->blocks; i += i & -i)
+    ri->tree[i] += delta;
+}
+
+/* Lines of blocks [0, blocks) */
+static int64_t tree_prefix(const RowIndex *ri, int64_t blocks) {
+  int64_t sum = 0;
+  for (int64_t i = blocks; i > 0; i -= i & -i)
+    sum += ri->tree[i];
+  return sum;
+}
+
+/* Build the tree from the lines: block sums, each pushed to its parent */
+static void tree_build(RowIndex *ri) {
+  for (int64_t b = 0; b < ri->blocks; b++) {
+    const unsigned char *lines = ri->lines + b * ROW_INDEX_BLOCK;
+    int64_t sum = 0;
+    for (int i = 0; i < ROW_INDEX_BLOCK; i++)
+      sum += lines[i];
+    ri->tree[b + 1] = sum;
+  }
+  for (int64_t i = 1; i <= ri->blocks; i++) {
+    int64_t parent = i + (i & -i);
+    if (parent <= ri->blocks)
+      ri->tree[parent] += ri->tree[i];
+  }
+}
+
+/* Make room for rows rows, doubling */
+static bool row_index_reserve(RowIndex *ri, int64_t rows) {
+  if (rows <= ri->capacity)
+    return true;
+
+  int64_t capacity = SDL_max(ri->capacity, 4 * ROW_INDEX_BLOCK);
+  while (capacity < rows)
+    capacity *= 2;
+
+  unsigned char *lines = realloc(ri->lines, (size_t)capacity);
+  if (!lines)
+    return false;
+  memset(lines + ri->capacity, 0, (size_t)(capacity - ri->capacity));
+  ri->lines = lines;
+
+  int64_t blocks = capacity / ROW_INDEX_BLOCK;
+  int64_t *tree = realloc(ri->tree, (size_t)(blocks + 1) * sizeof *tree);
+  if (!tree)
+    return false;
+  ri->tree = tree;
+
+  ri->capacity = capacity;
+  ri->blocks = blocks;
+  tree_build(ri);
+  return true;
+}
+
+bool row_index_insert(RowIndex *ri, int64_t row, int64_t count) {
+  if (!ri || count <= 0)
+    return ri != NULL;
+  row = SDL_clamp(row, 0, ri->count);
+  if (!row_index_reserve(ri, ri->count + count))
+    return false;
+
+  bool at_end = row == ri->count;
+  if (!at_end)
+    memmove(ri->lines + row + count, ri->lines + row,
+            (size_t)(ri->count - row));
+  memset(ri->lines + row, 1, (size_t)count);
+  ri->count += count;
+  ri->total += count;
+
+  if (!at_end) {
+    tree_build(ri);
+    return true;
+  }
+  /* Appended: one update per block touched */
+  for (int64_t r = row; r < row + count;) {
+    int64_t block = r / ROW_INDEX_BLOCK;
+    int64_t n = SDL_min(row + count, (block + 1) * ROW_INDEX_BLOCK) - r;
+    tree_add(ri, block, n);
+    r += n;
+  }
+  return true;
+}
+
+void row_index_remove(RowIndex *ri, int64_t row, int64_t count) {
+  if (!ri || row < 0 || row >= ri->count || count <= 0)
+    return;
+  count = SDL_min(count, ri->count - row);
+
+  for (int64_t r = row; r < row + count; r++)
+    ri->total -= ri->lines[r];
+  memmove(ri->lines + row, ri->lines + row + count,
+          (size_t)(ri->count - row - count));
+  memset(ri->lines + ri->count - count, 0, (size_t)count);
+  ri->count -= count;
+  tree_build(ri);
+}
+
+int64_t row_index_count(const RowIndex *ri) { return ri ? ri->count : 0; }
+
+int row_index_get(const RowIndex *ri, int64_t row) {
+  if (!ri || row < 0 || row >= ri->count)
+    return 1;
+  return ri->lines[row];
+}
+
+void row_index_set(RowIndex *ri, int64_t row, int lines) {
+  if (!ri || row < 0 || row >= ri->count)
+    return;
+  lines = SDL_clamp(lines, 1, ROW_MAX_LINES);
+
+  int delta = lines - ri->lines[row];
+  if (delta == 0)
+    return;
+  ri->lines[row] = (unsigned char)lines;
+  ri->total += delta;
+  tree_add(ri, row / ROW_INDEX_BLOCK, delta);
+}
+
+int64_t row_index_lines_before(const RowIndex *ri, int64_t row) {
+  if (!ri || row <= 0)
+    return SDL_max(row, 0);
+  if (row >= ri->count)
+    return ri->total + (row - ri->count);
+
+  int64_t block = row / ROW_INDEX_BLOCK;
+  int64_t sum = tree_prefix(ri, block);
+  for (int64_t r = block * ROW_INDEX_BLOCK; r < row; r++)
+    sum += ri->lines[r];
+  return sum;
+}
+
+int64_t row_index_find(const RowIndex *ri, double y, double row_px,
+                       double line_px, double *top) {
+  *top = 0.0;
+  if (y <= 0.0)
+    return 0;
+
+  int64_t count = ri ? ri->count : 0;
+  double end = (double)count * row_px +
+               (double)(ri ? ri->total : 0) * line_px;
+  if (y >= end) {
+    /* Past the last row: rows of one line */
+    double row_full = row_px + line_px;
+    int64_t extra = (int64_t)floor((y - end) / row_full);
+    if (end + (double)extra * row_full > y)
+      extra--;
+    else if (end + (double)(extra + 1) * row_full <= y)
+      extra++;
+    *top = end + (double)extra * row_full;
+    return count + extra;
+  }
+
+  /* Whole blocks above y. A tree node reaching past the last row counts
+   * full blocks, more than there is, so it is never taken: y is above the
+   * end */
+  int64_t step = 1;
+  while (step * 2 <= ri->blocks)
+    step *= 2;
+  int64_t block = 0;
+  double acc = 0.0;
+  for (; step > 0; step /= 2) {
+    if (block + step > ri->blocks)
+      continue;
+    double px = (double)(step * ROW_INDEX_BLOCK) * row_px +
+                (double)ri->tree[block + step] * line_px;
+    if (acc + px <= y) {
+      block += step;
+      acc += px;
+    }
+  }
+
+  /* Then rows of the block y is in */
+  int64_t row = block * ROW_INDEX_BLOCK;
+  for (; row < count - 1; row++) {
+    double h = row_px + (double)ri->lines[row] * line_px;
+    if (acc + h > y)
+      break;
+    acc += h;
+  }
+  *top = acc;
+  return row;
+}
@@ -25,13 +25,15 @@ void draw_scrollbars(const SizeAlloc *sa) {
                                                 SCROLLBAR_WIDTH, vert_bar_h});
 
     /* thumb size & position */
-    vert_thumb_h = SDL_max(10.0f, content_h * (content_h / sa->total_grid_h));
-    float max_offset_y_local = SDL_max(0.0f, sa->total_grid_h - content_h);
-    if (max_offset_y_local <= 0.0f) {
+    vert_thumb_h = SDL_max(
+        10.0f, (float)(content_h * (content_h / sa->total_grid_h)));
+    double max_offset_y_local = SDL_max(0.0, sa->total_grid_h - content_h);
+    if (max_offset_y_local <= 0.0) {
       vert_thumb_y = vert_bar_y;
     } else {
       float track_h = vert_bar_h - vert_thumb_h;
-      vert_thumb_y = vert_bar_y + (g_offset_y / max_offset_y_local) * track_h;
+      vert_thumb_y =
+          vert_bar_y + (float)(g_offset_y / max_offset_y_local) * track_h;
     }
     SDL_SetRenderDrawColour(g_renderer, SCROLLBAR_THUMB_COLOUR);
     SDL_RenderFillRect(g_renderer, &(SDL_FRect){vert_bar_x, vert_thumb_y,
@@ -47,13 +49,15 @@ void draw_scrollbars(const SizeAlloc *sa) {
     SDL_RenderFillRect(g_renderer, &(SDL_FRect){horz_bar_x, horz_bar_y,
                                                 horz_bar_w, SCROLLBAR_WIDTH});
 
-    horz_thumb_w = SDL_max(10.0f, content_w * (content_w / sa->total_grid_w));
-    float max_offset_x_local = SDL_max(0.0f, sa->total_grid_w - content_w);
-    if (max_offset_x_local <= 0.0f) {
+    horz_thumb_w = SDL_max(
+        10.0f, (float)(content_w * (content_w / sa->total_grid_w)));
+    double max_offset_x_local = SDL_max(0.0, sa->total_grid_w - content_w);
+    if (max_offset_x_local <= 0.0) {
       horz_thumb_x = horz_bar_x;
     } else {
       float track_w = horz_bar_w - horz_thumb_w;
-      horz_thumb_x = horz_bar_x + (g_offset_x / max_offset_x_local) * track_w;
+      horz_thumb_x =
+          horz_bar_x + (float)(g_offset_x / max_offset_x_local) * track_w;
     }
     SDL_SetRenderDrawColour(g_renderer, SCROLLBAR_THUMB_COLOUR);
     SDL_RenderFillRect(g_renderer, &(SDL_FRect){horz_thumb_x, horz_bar_y,
@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+#include "include/statx_ring.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct StatxRing {
+  int fd;
+  unsigned sq_entries;
+  unsigned cq_entries;
+
+  void *sq_ptr;
+  size_t sq_size;
+  void *cq_ptr;
+  size_t cq_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  /* Kernel writes results here, one slot per request in flight */
+  struct statx *stx;
+  /* Requests may still be running: stx must outlive the ring */
+  bool stx_busy;
+};
+
+static unsigned load_acquire(unsigned *p) {
+  return atomic_load_explicit((_Atomic unsigned *)p, memory_order_acquire);
+}
+
+static void store_release(unsigned *p, unsigned v) {
+  atomic_store_explicit((_Atomic unsigned *)p, v, memory_order_release);
+}
+
+StatxRing *statx_ring_create(unsigned depth) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof params);
+
+  int fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+  if (fd < 0)
+    return NULL;
+
+  StatxRing *ring = calloc(1, sizeof *ring);
+  if (!ring) {
+    close(fd);
+    return NULL;
+  }
+  ring->fd = fd;
+  ring->sq_entries = params.sq_entries;
+  ring->cq_entries = params.cq_entries;
+
+  ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    if (ring->cq_size > ring->sq_size)
+      ring->sq_size = ring->cq_size;
+    ring->cq_size = ring->sq_size;
+  }
+
+  ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ptr == MAP_FAILED) {
+    ring->sq_ptr = NULL;
+    goto fail;
+  }
+
+  if (single_mmap) {
+    ring->cq_ptr = ring->sq_ptr;
+  } else {
+    ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED) {
+      ring->cq_ptr = NULL;
+      goto fail;
+    }
+  }
+
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    goto fail;
+  }
+
+  char *sq = ring->sq_ptr;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+
+  char *cq = ring->cq_ptr;
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+  ring->stx = calloc(ring->sq_entries, sizeof *ring->stx);
+  if (!ring->stx)
+    goto fail;
+
+  return ring;
+
+fail:
+  statx_ring_destroy(ring);
+  return NULL;
+}
+
+void statx_ring_destroy(StatxRing *ring) {
+  if (!ring)
+    return;
+
+  if (ring->sqes)
+    munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr)
+    munmap(ring->cq_ptr, ring->cq_size);
+  if (ring->sq_ptr)
+    munmap(ring->sq_ptr, ring->sq_size);
+  close(ring->fd);
+  /* Teardown is asynchronous in the kernel: a statx still running after
+   * the fd is closed writes into stx, so it is left allocated */
+  if (!ring->stx_busy)
+    free(ring->stx);
+  free(ring);
+}
+
+static void statx_to_stat(const struct statx *stx, struct stat *st) {
+  memset(st, 0, sizeof *st);
+  st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+  st->st_ino = stx->stx_ino;
+  st->st_mode = stx->stx_mode;
+  st->st_nlink = stx->stx_nlink;
+  st->st_uid = stx->stx_uid;
+  st->st_gid = stx->stx_gid;
+  st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+  st->st_size = (off_t)stx->stx_size;
+  st->st_blksize = stx->stx_blksize;
+  st->st_blocks = (blkcnt_t)stx->stx_blocks;
+  st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+  st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+  st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+  st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+  st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+  st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+/* Consume the completions posted so far. Results go to st/res of the
+ * chunk starting at base unless st is NULL. Returns how many there were */
+static unsigned reap_completions(StatxRing *ring, unsigned chunk, int base,
+                                 struct stat *st, int *res) {
+  unsigned completed = 0;
+  unsigned head = *ring->cq_head;
+  unsigned cq_tail = load_acquire(ring->cq_tail);
+  unsigned cq_mask = *ring->cq_mask;
+  for (; head != cq_tail; head++) {
+    struct io_uring_cqe *cqe = &ring->cqes[head & cq_mask];
+    unsigned i = (unsigned)cqe->user_data;
+    if (i < chunk) {
+      if (st) {
+        res[base + (int)i] = cqe->res < 0 ? cqe->res : 0;
+        if (cqe->res >= 0)
+          statx_to_stat(&ring->stx[i], &st[base + (int)i]);
+      }
+      completed++;
+    }
+  }
+  store_release(ring->cq_head, head);
+  return completed;
+}
+
+/* Wait, without submitting anything more, until the requests submitted
+ * so far have completed, so that none of them writes into stx later. If
+ * even waiting fails, stx stays allocated for good (see
+ * statx_ring_destroy()) */
+static void drain_submitted(StatxRing *ring, unsigned chunk,
+                            unsigned submitted, unsigned completed) {
+  while (completed < submitted) {
+    int ret = (int)syscall(__NR_io_uring_enter, ring->fd, 0,
+                           submitted - completed, IORING_ENTER_GETEVENTS,
+                           NULL, 0);
+    if (ret < 0 && errno != EINTR) {
+      ring->stx_busy = true;
+      return;
+    }
+    completed += reap_completions(ring, chunk, 0, NULL, NULL);
+  }
+}
+
+bool statx_ring_stat(StatxRing *ring, int dirfd, const char *const *names,
+                     int count, int flags, struct stat *st, int *res) {
+  if (!ring || ring->stx_busy)
+    return false;
+
+  /* Chunks of at most one submission queue worth of requests */
+  for (int base = 0; base < count; base += (int)ring->sq_entries) {
+    unsigned chunk = (unsigned)(count - base);
+    if (chunk > ring->sq_entries)
+      chunk = ring->sq_entries;
+    if (chunk > ring->cq_entries)
+      chunk = ring->cq_entries;
+
+    unsigned tail = *ring->sq_tail;
+    unsigned mask = *ring->sq_mask;
+    for (unsigned i = 0; i < chunk; i++) {
+      unsigned slot = (tail + i) & mask;
+      struct io_uring_sqe *sqe = &ring->sqes[slot];
+      memset(sqe, 0, sizeof *sqe);
+      sqe->opcode = IORING_OP_STATX;
+      sqe->fd = dirfd;
+      sqe->addr = (unsigned long)names[base + (int)i];
+      sqe->len = STATX_BASIC_STATS;
+      sqe->off = (unsigned long)&ring->stx[i];
+      sqe->statx_flags = (unsigned)flags;
+      sqe->user_data = i;
+      ring->sq_array[slot] = slot;
+    }
+    store_release(ring->sq_tail, tail + chunk);
+
+    unsigned submitted = 0, completed = 0;
+    while (completed < chunk) {
+      unsigned to_submit = chunk - submitted;
+      int ret = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit,
+                             chunk - completed, IORING_ENTER_GETEVENTS, NULL,
+                             0);
+      if (ret < 0) {
+        if (errno == EINTR)
+          continue;
+        /* The ring is no longer usable; what was submitted still runs and
+         * has to finish before stx may go */
+        drain_submitted(ring, chunk, submitted, completed);
+        return false;
+      }
+      submitted += (unsigned)ret;
+      completed += reap_completions(ring, chunk, base, st, res);
+    }
+  }
+
+  return true;
+}
+
+#else
+
+/* No io_uring on this platform: callers always use the plain syscalls */
+StatxRing *statx_ring_create(unsigned depth) {
+  (void)depth;
+  return NULL;
+}
+
+void statx_ring_destroy(StatxRing *ring) { (void)ring; }
+
+bool statx_ring_stat(StatxRing *ring, int dirfd, const char *const *names,
+                     int count, int flags, struct stat *st, int *res) {
+  (void)ring;
+  (void)dirfd;
+  (void)names;
+  (void)count;
+  (void)flags;
+  (void)st;
+  (void)res;
+  return false;
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "include/table_model.h"
+#include "include/config.h"
 #include "include/fs.h"
 #include <SDL3/SDL.h>
 #include <SDL3_ttf/SDL_ttf.h>
@@ -16,11 +17,25 @@ TableModel *table_create(DataProvider *provider, ColumnRegistry *cols) {
   table->provider = provider;
   table->columns = cols;
   table->col_widths = NULL;
+  table->measure = NULL;
+  table->measure_ctx = NULL;
+  table->widths = NULL;
+  table->measured_rows = 0;
+  table->measure_text = NULL;
+  table->measure_offsets = NULL;
+  table->measure_cols = 0;
+  table->row_lines = row_index_create();
   table->mutex = SDL_CreateMutex();
   table->widths_dirty = true;
+  table->widths_version = 0;
   table->structure_dirty = false;
 
-  if (!table->mutex) {
+  int64_t rows = provider->ops.row_count(provider->ctx);
+  if (!table->mutex || !table->row_lines ||
+      !row_index_insert(table->row_lines, 0, rows)) {
+    if (table->mutex)
+      SDL_DestroyMutex(table->mutex);
+    row_index_destroy(table->row_lines);
     free(table);
     return NULL;
   }
@@ -29,6 +44,7 @@ TableModel *table_create(DataProvider *provider, ColumnRegistry *cols) {
   if (cols->count > 0) {
     table->col_widths = calloc((size_t)cols->count, sizeof *table->col_widths);
     if (!table->col_widths) {
+      row_index_destroy(table->row_lines);
       SDL_DestroyMutex(table->mutex);
       free(table);
       return NULL;
@@ -38,6 +54,15 @@ TableModel *table_create(DataProvider *provider, ColumnRegistry *cols) {
     for (int c = 0; c < cols->count; c++) {
       table->col_widths[c] = cols->columns[c].width_min;
     }
+
+    table->widths = calloc((size_t)cols->count, sizeof *table->widths);
+    if (!table->widths) {
+      free(table->col_widths);
+      row_index_destroy(table->row_lines);
+      SDL_DestroyMutex(table->mutex);
+      free(table);
+      return NULL;
+    }
   }
 
   return table;
@@ -51,11 +76,20 @@ void table_destroy(TableModel *table) {
     provider_destroy(table->provider);
   }
 
+  if (table->widths) {
+    for (int c = 0; c < table->columns->count; c++)
+      free(table->widths[c].count);
+    free(table->widths);
+  }
+
   if (table->columns) {
     cols_destroy(table->columns);
   }
 
   free(table->col_widths);
+  free(table->measure_text);
+  free(table->measure_offsets);
+  row_index_destroy(table->row_lines);
 
   if (table->mutex) {
     SDL_DestroyMutex(table->mutex);
@@ -64,48 +98,480 @@ void table_destroy(TableModel *table) {
   free(table);
 }
 
-char *table_get_cell(TableModel *table, int row, int col) {
+/* Copy text into buf the way the format callbacks do */
+static size_t copy_text(const char *text, char *buf, size_t cap) {
+  size_t len = text ? strlen(text) : 0;
+  if (len >= cap)
+    len = cap - 1;
+  if (len > 0)
+    memcpy(buf, text, len);
+  buf[len] = '\0';
+  return len;
+}
+
+/* Format one cell of a row whose data is already resolved. The table
+ * mutex must be held */
+static size_t format_cell_locked(TableModel *table, int64_t row, int col,
+                                 void *row_data, char *buf, size_t cap) {
+  ProviderOps *ops = &table->provider->ops;
+  void *ctx = table->provider->ctx;
+
+  buf[0] = '\0';
+  if (col < 0 || col >= table->columns->count)
+    return 0;
+
+  ColumnDef *col_def = &table->columns->columns[col];
+
+  if (col_def->format_cell && row_data)
+    return col_def->format_cell((void *)col_def, row_data, buf, cap);
+
+  if (col_def->render_cell && row_data) {
+    /* Legacy renderer returns malloc'd text */
+    char *text = col_def->render_cell((void *)col_def, row_data);
+    size_t len = copy_text(text, buf, cap);
+    free(text);
+    return len;
+  }
+
+  if (ops->format_cell)
+    return ops->format_cell(ctx, row, col, buf, cap);
+
+  /* Fallback: get from provider */
+  char *text = ops->get_cell(ctx, row, col);
+  size_t len = copy_text(text, buf, cap);
+  free(text);
+  return len;
+}
+
+size_t table_format_cell(TableModel *table, int64_t row, int col, char *buf,
+                         size_t cap) {
+  if (!buf || cap == 0)
+    return 0;
+  buf[0] = '\0';
   if (!table || row < 0 || col < 0)
-    return strdup("");
+    return 0;
 
   SDL_LockMutex(table->mutex);
 
-  if (col >= table->columns->count) {
-    SDL_UnlockMutex(table->mutex);
-    return strdup("");
+  ProviderOps *ops = &table->provider->ops;
+  void *ctx = table->provider->ctx;
+  size_t len = 0;
+
+  if (col < table->columns->count && row < ops->row_count(ctx)) {
+    void *row_data = ops->get_row_data(ctx, row);
+    len = format_cell_locked(table, row, col, row_data, buf, cap);
   }
 
-  int row_count = table->provider->ops.row_count(table->provider->ctx);
-  if (row >= row_count) {
-    SDL_UnlockMutex(table->mutex);
-    return strdup("");
+  SDL_UnlockMutex(table->mutex);
+
+  return len;
+}
+
+/* The provider may format the range itself only if no requested column
+ * has a formatter of its own */
+static bool provider_formats_range(TableModel *table, const int *cols,
+                                   int ncols) {
+  if (!table->provider->ops.format_cells)
+    return false;
+
+  for (int i = 0; i < ncols; i++) {
+    int col = cols ? cols[i] : i;
+    if (col < 0 || col >= table->columns->count)
+      return false;
+    ColumnDef *col_def = &table->columns->columns[col];
+    if (col_def->format_cell || col_def->render_cell)
+      return false;
   }
+  return true;
+}
 
-  ColumnDef *col_def = &table->columns->columns[col];
-  void *row_data = table->provider->ops.get_row_data(table->provider->ctx, row);
+/* Resolve the row data of up to COLUMN_BULK_ROWS rows from `row` and let
+ * the columns with a format_column hook format them. Returns how many rows
+ * the pass covers. The table mutex must be held */
+static int bulk_pass_run(TableModel *table, BulkPass *pass, int64_t row,
+                         int count, const int *cols, int ncols) {
+  ProviderOps *ops = &table->provider->ops;
+  void *ctx = table->provider->ctx;
+  bool all_data = true;
+
+  count = SDL_min(count, COLUMN_BULK_ROWS);
+  for (int k = 0; k < count; k++) {
+    pass->rows[k] = ops->get_row_data(ctx, row + k);
+    all_data = all_data && pass->rows[k];
+  }
 
-  char *result = NULL;
+  pass->bulk_count = 0;
+  for (int i = 0; i < ncols && all_data && pass->bulk_count < TABLE_BULK_COLS;
+       i++) {
+    int col = cols ? cols[i] : i;
+    if (col < 0 || col >= table->columns->count)
+      continue;
+    ColumnDef *col_def = &table->columns->columns[col];
+    if (!col_def->format_column)
+      continue;
+
+    int b = pass->bulk_count;
+    int n = col_def->format_column((void *)col_def, pass->rows, count,
+                                   pass->text[b], TABLE_BULK_TEXT,
+                                   pass->offsets[b]);
+    if (n > 0) {
+      pass->bulk_index[b] = i;
+      pass->bulk_count++;
+      count = SDL_min(count, n);
+    }
+  }
+  return count;
+}
 
-  /* Use custom renderer if available */
-  if (col_def->render_cell && row_data) {
-    result = col_def->render_cell((void *)col_def, row_data);
-  } else {
-    /* Fallback: get from provider */
-    result = table->provider->ops.get_cell(table->provider->ctx, row, col);
+/* Text of the i-th requested column in row k of the pass, NULL if that
+ * column is formatted cell by cell */
+static const char *bulk_pass_cell(const BulkPass *pass, int i, int k) {
+  for (int b = 0; b < pass->bulk_count; b++) {
+    if (pass->bulk_index[b] == i)
+      return pass->text[b] + pass->offsets[b][k];
+  }
+  return NULL;
+}
+
+/* table_format_cells() with the table mutex held */
+static int format_cells_locked(TableModel *table, int64_t row_begin,
+                               int64_t row_end, const int *cols, int ncols,
+                               char *text, size_t cap, size_t *offsets) {
+  ProviderOps *ops = &table->provider->ops;
+  void *ctx = table->provider->ctx;
+  row_end = SDL_min(row_end, ops->row_count(ctx));
+
+  if (row_end > row_begin && provider_formats_range(table, cols, ncols))
+    return ops->format_cells(ctx, row_begin, row_end, cols, ncols, text, cap,
+                             offsets);
+
+  /* Rows go in runs of COLUMN_BULK_ROWS: columns with a bulk formatter
+   * format the whole run first, the rest cell by cell */
+  BulkPass *pass = &table->bulk;
+  size_t used = 0;
+  int64_t row = row_begin;
+  bool full = false;
+  while (row < row_end && !full) {
+    int run = bulk_pass_run(table, pass, row,
+                            (int)SDL_min(row_end - row, COLUMN_BULK_ROWS),
+                            cols, ncols);
+
+    for (int k = 0; k < run && !full; k++) {
+      size_t row_start = used;
+      bool fits = true;
+
+      for (int i = 0; i < ncols && fits; i++) {
+        size_t cell_cap = SDL_min(cap - used, (size_t)TABLE_CELL_MAX);
+        if (cell_cap == 0) {
+          fits = false;
+          break;
+        }
+
+        const char *bulk = bulk_pass_cell(pass, i, k);
+        size_t len;
+        if (bulk) {
+          len = strlen(bulk);
+          if (len >= cell_cap) {
+            fits = false;
+            break;
+          }
+          memcpy(text + used, bulk, len + 1);
+        } else if (cell_cap == TABLE_CELL_MAX) {
+          len = format_cell_locked(table, row, cols ? cols[i] : i,
+                                   pass->rows[k], text + used, cell_cap);
+        } else {
+          /* Near the end of text: format aside, as a formatter may cut the
+           * cell or (like strftime) leave it empty when it does not fit */
+          char cell[TABLE_CELL_MAX];
+          len = format_cell_locked(table, row, cols ? cols[i] : i,
+                                   pass->rows[k], cell, sizeof cell);
+          if (len >= cell_cap) {
+            fits = false;
+            break;
+          }
+          memcpy(text + used, cell, len + 1);
+        }
+        offsets[(size_t)(row - row_begin) * ncols + i] = used;
+        used += len + 1;
+      }
+
+      if (fits) {
+        row++;
+      } else {
+        used = row_start;
+        full = true;
+      }
+    }
+  }
+
+  return (int)SDL_max(0, row - row_begin);
+}
+
+int table_format_cells(TableModel *table, int64_t row_begin, int64_t row_end,
+                       const int *cols, int ncols, char *text, size_t cap,
+                       size_t *offsets) {
+  if (!table || !text || !offsets || cap == 0 || row_begin < 0 ||
+      ncols <= 0)
+    return 0;
+
+  SDL_LockMutex(table->mutex);
+  int rows = format_cells_locked(table, row_begin, row_end, cols, ncols, text,
+                                 cap, offsets);
+  SDL_UnlockMutex(table->mutex);
+
+  return rows;
+}
+
+/* Count one more cell of `width`. Returns true if the widest changed */
+static bool column_widths_add(ColumnWidths *w, int width) {
+  width = SDL_max(width, 0);
+  if (width >= w->len) {
+    int len = SDL_max(SDL_max(w->len * 2, width + 1), 64);
+    unsigned *count = realloc(w->count, (size_t)len * sizeof *count);
+    if (!count)
+      return false;
+    memset(count + w->len, 0, (size_t)(len - w->len) * sizeof *count);
+    w->count = count;
+    w->len = len;
+  }
+
+  w->count[width]++;
+  if (width <= w->max)
+    return false;
+  w->max = width;
+  return true;
+}
+
+/* Count one cell of `width` less. Returns true if the widest changed */
+static bool column_widths_remove(ColumnWidths *w, int width) {
+  width = SDL_max(width, 0);
+  if (width >= w->len || w->count[width] == 0)
+    return false;
+
+  w->count[width]--;
+  if (width != w->max || w->count[width] > 0)
+    return false;
+  /* The last of the widest went: step down to the next width in use */
+  while (w->max > 0 && w->count[w->max] == 0)
+    w->max--;
+  return true;
+}
+
+typedef enum {
+  MEASURE_ADD,    /* count the cells in, and the lines of their rows */
+  MEASURE_REMOVE, /* take the cells out */
+  MEASURE_LINES,  /* only count the lines of the rows again */
+} MeasureMode;
+
+/* Width of the widest line of a cell; its lines go to *lines */
+static int measure_cell_locked(TableModel *table, const char *cell,
+                               int *lines) {
+  int width = 0;
+  *lines = 0;
+  for (;;) {
+    size_t len = strcspn(cell, "\n");
+    width = SDL_max(width, table->measure(table->measure_ctx, cell, len));
+    ++*lines;
+    if (cell[len] == '\0')
+      return width;
+    cell += len + 1;
+  }
+}
+
+static int count_lines(const char *cell) {
+  int lines = 1;
+  while ((cell = strchr(cell, '\n')))
+    cell++, lines++;
+  return lines;
+}
+
+/* Room in the measuring scratch for a run of rows of ncols columns, and
+ * always for one. The table mutex must be held */
+static bool measure_scratch_locked(TableModel *table, int ncols) {
+  if (ncols <= table->measure_cols)
+    return true;
+
+  char *text = realloc(table->measure_text, (size_t)ncols * TABLE_CELL_MAX);
+  if (!text)
+    return false;
+  table->measure_text = text;
+
+  size_t *offsets = realloc(table->measure_offsets, (size_t)ncols *
+                                                        COLUMN_BULK_ROWS *
+                                                        sizeof *offsets);
+  if (!offsets)
+    return false;
+  table->measure_offsets = offsets;
+
+  table->measure_cols = ncols;
+  return true;
+}
+
+/* Count the cells of rows [row_begin, row_end) in columns cols[0..ncols)
+ * (the first ncols if cols is NULL) in the width statistics and the lines
+ * of the rows, or take them out. Lines measured from some of the columns
+ * only ever make a row taller. The table mutex must be held */
+static void measure_rows_locked(TableModel *table, int64_t row_begin,
+                                int64_t row_end, const int *cols, int ncols,
+                                MeasureMode mode) {
+  if (!table->measure || !table->widths || ncols <= 0 || row_begin < 0 ||
+      row_end <= row_begin)
+    return;
+
+  if (!measure_scratch_locked(table, ncols))
+    return;
+
+  bool all_cols = !cols && ncols == table->columns->count;
+  char *text = table->measure_text;
+  size_t *offsets = table->measure_offsets;
+  size_t cap = (size_t)ncols * TABLE_CELL_MAX;
+  bool changed = false, lines_changed = false;
+
+  int64_t row = row_begin;
+  while (row < row_end) {
+    int n = format_cells_locked(table, row,
+                                SDL_min(row_end, row + COLUMN_BULK_ROWS),
+                                cols, ncols, text, cap, offsets);
+    if (n <= 0)
+      break;
+
+    for (int r = 0; r < n; r++) {
+      const size_t *cells = offsets + (size_t)r * ncols;
+      int row_lines = all_cols ? 1 : row_index_get(table->row_lines, row + r);
+
+      for (int i = 0; i < ncols; i++) {
+        int lines;
+        if (mode == MEASURE_LINES) {
+          lines = count_lines(text + cells[i]);
+        } else {
+          int width = measure_cell_locked(table, text + cells[i], &lines);
+          ColumnWidths *w = &table->widths[cols ? cols[i] : i];
+          changed |= mode == MEASURE_REMOVE ? column_widths_remove(w, width)
+                                            : column_widths_add(w, width);
+        }
+        row_lines = SDL_max(row_lines, lines);
+      }
+
+      row_lines = SDL_min(row_lines, ROW_MAX_LINES);
+      if (mode != MEASURE_REMOVE &&
+          row_lines != row_index_get(table->row_lines, row + r)) {
+        row_index_set(table->row_lines, row + r, row_lines);
+        lines_changed = true;
+      }
+    }
+    row += n;
+  }
+
+  if (changed)
+    table->widths_dirty = true;
+  if (changed || lines_changed)
+    table->widths_version++;
+}
+
+/* The table mutex must be held */
+static void measure_headers_locked(TableModel *table) {
+  if (!table->measure || !table->widths)
+    return;
+
+  char text[TABLE_CELL_MAX];
+  for (int c = 0; c < table->columns->count; c++) {
+    table_format_header(table, c, text, sizeof text);
+    int lines; /* the header row stays one line high */
+    int width = measure_cell_locked(table, text, &lines);
+    if (width != table->widths[c].header) {
+      table->widths[c].header = width;
+      table->widths_dirty = true;
+      table->widths_version++;
+    }
+  }
+}
+
+/* Make room in the width statistics for the column just put at col_idx
+ * and measure it. The table mutex must be held */
+static bool widths_insert_locked(TableModel *table, int col_idx) {
+  int count = table->columns->count;
+  ColumnWidths *widths =
+      realloc(table->widths, (size_t)count * sizeof *widths);
+  if (!widths)
+    return false;
+
+  memmove(widths + col_idx + 1, widths + col_idx,
+          (size_t)(count - 1 - col_idx) * sizeof *widths);
+  widths[col_idx] = (ColumnWidths){0};
+  table->widths = widths;
+
+  measure_headers_locked(table);
+  measure_rows_locked(table, 0, table->measured_rows, &col_idx, 1,
+                      MEASURE_ADD);
+  return true;
+}
+
+void table_set_measure(TableModel *table, TableMeasureFn fn, void *ctx) {
+  if (!table)
+    return;
+
+  SDL_LockMutex(table->mutex);
+
+  if (table->widths) {
+    for (int c = 0; c < table->columns->count; c++) {
+      free(table->widths[c].count);
+      table->widths[c] = (ColumnWidths){0};
+    }
+  }
+  table->measure = fn;
+  table->measure_ctx = ctx;
+  table->measured_rows = 0;
+
+  measure_headers_locked(table);
+  table->widths_dirty = true;
+  table->widths_version++;
+
+  SDL_UnlockMutex(table->mutex);
+}
+
+int64_t table_measure_pending(TableModel *table, int64_t budget) {
+  if (!table || budget <= 0)
+    return 0;
+
+  SDL_LockMutex(table->mutex);
+
+  int64_t measured = 0;
+  if (table->measure) {
+    int64_t rows = table->provider->ops.row_count(table->provider->ctx);
+    int64_t end = SDL_min(rows, table->measured_rows + budget);
+    measure_rows_locked(table, table->measured_rows, end, NULL,
+                        table->columns->count, MEASURE_ADD);
+    measured = end - table->measured_rows;
+    table->measured_rows = end;
   }
 
   SDL_UnlockMutex(table->mutex);
 
-  return result ? result : strdup("");
+  return measured;
 }
 
-void *table_get_row_data(TableModel *table, int row) {
+void table_measure_headers(TableModel *table) {
+  if (!table)
+    return;
+
+  SDL_LockMutex(table->mutex);
+  measure_headers_locked(table);
+  SDL_UnlockMutex(table->mutex);
+}
+
+char *table_get_cell(TableModel *table, int64_t row, int col) {
+  char buf[TABLE_CELL_MAX];
+  table_format_cell(table, row, col, buf, sizeof buf);
+  return strdup(buf);
+}
+
+void *table_get_row_data(TableModel *table, int64_t row) {
   if (!table || row < 0)
     return NULL;
 
   SDL_LockMutex(table->mutex);
 
-  int row_count = table->provider->ops.row_count(table->provider->ctx);
+  int64_t row_count = table->provider->ops.row_count(table->provider->ctx);
   if (row >= row_count) {
     SDL_UnlockMutex(table->mutex);
     return NULL;
@@ -118,12 +584,12 @@ void *table_get_row_data(TableModel *table, int row) {
   return result;
 }
 
-int table_get_row_count(TableModel *table) {
+int64_t table_get_row_count(TableModel *table) {
   if (!table)
     return 0;
 
   SDL_LockMutex(table->mutex);
-  int count = table->provider->ops.row_count(table->provider->ctx);
+  int64_t count = table->provider->ops.row_count(table->provider->ctx);
   SDL_UnlockMutex(table->mutex);
 
   return count;
@@ -140,29 +606,77 @@ int table_get_col_count(TableModel *table) {
   return count;
 }
 
-bool table_insert_row(TableModel *table, int row, void *data) {
+bool table_insert_row(TableModel *table, int64_t row, void *data) {
   if (!table)
     return false;
 
   SDL_LockMutex(table->mutex);
-  bool result =
-      table->provider->ops.insert_row(table->provider->ctx, row, data);
+  bool result = row_index_insert(table->row_lines, row, 1);
   if (result) {
-    table->widths_dirty = true; /* Mark for recalculation */
+    result = table->provider->ops.insert_row(table->provider->ctx, row, data);
+    if (result && row < table->measured_rows) {
+      /* Among the measured rows; past them it is measured with the rest */
+      measure_rows_locked(table, row, row + 1, NULL, table->columns->count,
+                          MEASURE_ADD);
+      table->measured_rows++;
+    } else if (!result)
+      row_index_remove(table->row_lines, row, 1);
+  }
+  SDL_UnlockMutex(table->mutex);
+
+  return result;
+}
+
+bool table_append_rows(TableModel *table, void **rows, int count) {
+  if (!table || !rows || count < 0)
+    return false;
+  if (count == 0)
+    return true;
+
+  SDL_LockMutex(table->mutex);
+
+  ProviderOps *ops = &table->provider->ops;
+  void *ctx = table->provider->ctx;
+  int64_t first = ops->row_count(ctx);
+  if (!row_index_insert(table->row_lines, first, count)) {
+    SDL_UnlockMutex(table->mutex);
+    return false;
+  }
+
+  bool result = true;
+  if (ops->append_rows) {
+    result = ops->append_rows(ctx, rows, count);
+  } else {
+    for (int i = 0; i < count && result; i++) {
+      result = ops->insert_row(ctx, first + i, rows[i]);
+    }
   }
+
+  /* Rows the provider did not take */
+  int64_t last = ops->row_count(ctx);
+  row_index_remove(table->row_lines, last, first + count - last);
+
   SDL_UnlockMutex(table->mutex);
 
   return result;
 }
 
-bool table_delete_row(TableModel *table, int row) {
+bool table_delete_row(TableModel *table, int64_t row) {
   if (!table)
     return false;
 
   SDL_LockMutex(table->mutex);
+  int ncols = table->columns->count;
+  bool measured = row >= 0 && row < table->measured_rows;
+  if (measured)
+    measure_rows_locked(table, row, row + 1, NULL, ncols, MEASURE_REMOVE);
   bool result = table->provider->ops.delete_row(table->provider->ctx, row);
   if (result) {
-    table->widths_dirty = true; /* Mark for recalculation */
+    row_index_remove(table->row_lines, row, 1);
+    if (measured)
+      table->measured_rows--;
+  } else if (measured) {
+    measure_rows_locked(table, row, row + 1, NULL, ncols, MEASURE_ADD);
   }
   SDL_UnlockMutex(table->mutex);
 
@@ -175,7 +689,10 @@ bool table_add_column(TableModel *table, ColumnDef col) {
 
   SDL_LockMutex(table->mutex);
 
-  cols_add(table->columns, col);
+  if (!cols_add(table->columns, col)) {
+    SDL_UnlockMutex(table->mutex);
+    return false;
+  }
 
   /* Reallocate widths array */
   int *new_widths = realloc(table->col_widths,
@@ -188,7 +705,15 @@ bool table_add_column(TableModel *table, ColumnDef col) {
 
   table->col_widths = new_widths;
   table->col_widths[table->columns->count - 1] = col.width_min;
+
+  if (!widths_insert_locked(table, table->columns->count - 1)) {
+    cols_remove(table->columns, table->columns->count - 1);
+    SDL_UnlockMutex(table->mutex);
+    return false;
+  }
+
   table->widths_dirty = true;
+  table->widths_version++;
   table->structure_dirty = true;
 
   SDL_UnlockMutex(table->mutex);
@@ -197,23 +722,37 @@ bool table_add_column(TableModel *table, ColumnDef col) {
 }
 
 /* Helper: Get header text for a column */
-char *table_get_header(TableModel *table, int col_idx) {
+size_t table_format_header(TableModel *table, int col_idx, char *buf,
+                           size_t cap) {
+  if (!buf || cap == 0)
+    return 0;
+  buf[0] = '\0';
   if (!table || col_idx < 0 || col_idx >= table->columns->count)
-    return strdup("");
+    return 0;
 
   ColumnDef *col_def = &table->columns->columns[col_idx];
 
   /* Use custom renderer if available */
   if (col_def->render_header) {
-    return col_def->render_header(col_def->user_data);
+    char *text = col_def->render_header(col_def->user_data);
+    size_t len = copy_text(text, buf, cap);
+    free(text);
+    return len;
   }
 
-  /* Use header_template with substitutions (like %P, %b, etc.) */
-  if (col_def->header_template) {
-    return render_header_template(col_def->header_template);
+  /* Use header_template with substitutions (like %P, %b, etc.),
+   * compiled when the column was registered */
+  if (col_def->header_tpl) {
+    return fs_format_header(col_def->header_tpl, buf, cap);
   }
 
-  return strdup("");
+  return 0;
+}
+
+char *table_get_header(TableModel *table, int col_idx) {
+  char buf[TABLE_CELL_MAX];
+  table_format_header(table, col_idx, buf, sizeof buf);
+  return strdup(buf);
 }
 
 bool table_insert_column(TableModel *table, int col_idx, ColumnDef col) {
@@ -222,7 +761,10 @@ bool table_insert_column(TableModel *table, int col_idx, ColumnDef col) {
 
   SDL_LockMutex(table->mutex);
 
-  cols_insert(table->columns, col_idx, col);
+  if (!cols_insert(table->columns, col_idx, col)) {
+    SDL_UnlockMutex(table->mutex);
+    return false;
+  }
 
   /* Reallocate widths array */
   int *new_widths = realloc(table->col_widths,
@@ -241,7 +783,17 @@ bool table_insert_column(TableModel *table, int col_idx, ColumnDef col) {
   }
   table->col_widths[col_idx] = col.width_min;
 
+  if (!widths_insert_locked(table, col_idx)) {
+    cols_remove(table->columns, col_idx);
+    memmove(table->col_widths + col_idx, table->col_widths + col_idx + 1,
+            (size_t)(table->columns->count - col_idx) *
+                sizeof *table->col_widths);
+    SDL_UnlockMutex(table->mutex);
+    return false;
+  }
+
   table->widths_dirty = true;
+  table->widths_version++;
   table->structure_dirty = true;
 
   SDL_UnlockMutex(table->mutex);
@@ -273,7 +825,22 @@ bool table_remove_column(TableModel *table, int col_idx) {
   }
 
   table->col_widths = new_widths;
+
+  if (table->widths) {
+    free(table->widths[col_idx].count);
+    memmove(table->widths + col_idx, table->widths + col_idx + 1,
+            (size_t)(table->columns->count - col_idx) *
+                sizeof *table->widths);
+  }
+
+  /* Rows the column made taller shrink back */
+  int64_t rows = table->measured_rows;
+  if (row_index_lines_before(table->row_lines, rows) > rows)
+    measure_rows_locked(table, 0, rows, NULL, table->columns->count,
+                        MEASURE_LINES);
+
   table->widths_dirty = true;
+  table->widths_version++;
   table->structure_dirty = true;
 
   SDL_UnlockMutex(table->mutex);
@@ -292,27 +859,109 @@ ColumnDef *table_get_column(TableModel *table, int col_idx) {
   return result;
 }
 
-void table_recalc_widths(TableModel *table, TTF_Font *font, int padding) {
-  if (!table || !font || !table->col_widths)
-    return;
+unsigned table_get_widths_version(TableModel *table) {
+  if (!table)
+    return 0;
 
   SDL_LockMutex(table->mutex);
+  unsigned version = table->widths_version;
+  SDL_UnlockMutex(table->mutex);
 
-  /* Use g_max_col_widths which was updated by set_cell_with_width_update */
-  extern int *g_max_col_widths;
-  extern int g_cols;
+  return version;
+}
 
-  for (int c = 0; c < table->columns->count; c++) {
-    int max_width = table->columns->columns[c].width_min;
+int table_get_row_lines(TableModel *table, int64_t row) {
+  if (!table)
+    return 1;
+
+  SDL_LockMutex(table->mutex);
+  int lines = row_index_get(table->row_lines, row);
+  SDL_UnlockMutex(table->mutex);
+
+  return lines;
+}
+
+int64_t table_get_lines_before(TableModel *table, int64_t row) {
+  if (!table)
+    return SDL_max(row, 0);
+
+  SDL_LockMutex(table->mutex);
+  int64_t lines = row_index_lines_before(table->row_lines, row);
+  SDL_UnlockMutex(table->mutex);
+
+  return lines;
+}
+
+int64_t table_find_row(TableModel *table, double y, double row_px,
+                       double line_px, double *top) {
+  if (!table) {
+    *top = 0.0;
+    return 0;
+  }
+
+  SDL_LockMutex(table->mutex);
+  int64_t row = row_index_find(table->row_lines, y, row_px, line_px, top);
+  SDL_UnlockMutex(table->mutex);
+
+  return row;
+}
 
-    /* Use g_max_col_widths if available (tracks all text widths) */
-    if (g_max_col_widths && c < g_cols) {
-      max_width = g_max_col_widths[c] + 2 * padding;
+int table_get_content_widths(TableModel *table, int padding, int *widths,
+                             int cap) {
+  if (!table || !widths)
+    return 0;
+
+  SDL_LockMutex(table->mutex);
+  int count = SDL_min(cap, table->columns->count);
+  for (int c = 0; c < count; c++) {
+    int width = 0;
+    if (table->widths) {
+      ColumnWidths *w = &table->widths[c];
+      width = SDL_max(w->max, w->header);
+    }
+    widths[c] =
+        SDL_max(width + 2 * padding, table->columns->columns[c].width_min);
+  }
+  SDL_UnlockMutex(table->mutex);
+
+  return count;
+}
+
+int table_get_text_width(TableModel *table, int col_idx) {
+  if (!table || col_idx < 0)
+    return 0;
+
+  SDL_LockMutex(table->mutex);
+  int width = 0;
+  if (table->widths && col_idx < table->columns->count) {
+    ColumnWidths *w = &table->widths[col_idx];
+    width = SDL_max(w->max, w->header);
+  }
+  SDL_UnlockMutex(table->mutex);
+
+  return width;
+}
+
+void table_recalc_widths(TableModel *table, int padding) {
+  if (!table || !table->col_widths)
+    return;
+
+  SDL_LockMutex(table->mutex);
+
+  for (int c = 0; c < table->columns->count; c++) {
+    ColumnDef *col_def = &table->columns->columns[c];
+    int max_width = col_def->width_min;
+
+    /* Widest text, tracked as rows come and go */
+    if (table->widths) {
+      ColumnWidths *w = &table->widths[c];
+      max_width =
+          SDL_max(max_width, SDL_max(w->max, w->header) + 2 * padding);
     }
 
     /* Clamp to max */
-    if (table->columns->columns[c].width_max > 0) {
-      max_width = SDL_min(max_width, table->columns->columns[c].width_max);
+    if (col_def->width_max > 0) {
+      max_width = SDL_min(max_width, col_def->width_max);
     }
 
     table->col_widths[c] = max_width;
@@ -339,8 +988,10 @@ void table_mark_dirty(TableModel *table, bool widths, bool structure) {
     return;
 
   SDL_LockMutex(table->mutex);
-  if (widths)
+  if (widths) {
     table->widths_dirty = true;
+    table->widths_version++;
+  }
   if (structure)
     table->structure_dirty = true;
   SDL_UnlockMutex(table->mutex);
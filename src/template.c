@@ -0,0 +1,116 @@
+/* src/template.c */
+#include "include/template.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char field;    /* 0 for literal text */
+  size_t offset; /* literal: span in Template.text */
+  size_t len;
+} TemplateOp;
+
+struct Template {
+  int count;
+  char *text; /* literal spans, stored after the ops */
+  TemplateOp ops[];
+};
+
+Template *template_compile(const char *src, const char *fields) {
+  if (!src)
+    return NULL;
+
+  /* Every op covers at least one source character, and literal text is
+   * never longer than its source */
+  size_t src_len = strlen(src);
+  Template *tpl = malloc(sizeof *tpl + (src_len + 1) * sizeof(TemplateOp) +
+                         src_len + 1);
+  if (!tpl)
+    return NULL;
+  tpl->count = 0;
+  tpl->text = (char *)&tpl->ops[src_len + 1];
+
+  size_t text_len = 0;
+  TemplateOp *lit = NULL; /* literal op being extended */
+
+  for (const char *s = src; *s; s++) {
+    char c = *s;
+    if (c == '%' && s[1] != '\0') {
+      char t = *++s;
+      if (t != '%' && fields && strchr(fields, t)) {
+        tpl->ops[tpl->count++] = (TemplateOp){.field = t};
+        lit = NULL;
+        continue;
+      }
+      if (t != '%') {
+        /* Unknown escape: kept as written */
+        if (!lit) {
+          lit = &tpl->ops[tpl->count++];
+          *lit = (TemplateOp){.offset = text_len};
+        }
+        tpl->text[text_len++] = '%';
+        lit->len++;
+      }
+      c = t;
+    }
+
+    if (!lit) {
+      lit = &tpl->ops[tpl->count++];
+      *lit = (TemplateOp){.offset = text_len};
+    }
+    tpl->text[text_len++] = c;
+    lit->len++;
+  }
+  tpl->text[text_len] = '\0';
+
+  return tpl;
+}
+
+void template_free(Template *tpl) { free(tpl); }
+
+size_t template_expand(const Template *tpl, char *buf, size_t cap,
+                       TemplateFieldFn field, void *ctx) {
+  if (!buf || cap == 0)
+    return 0;
+  buf[0] = '\0';
+  if (!tpl)
+    return 0;
+
+  char scratch[PATH_MAX];
+  size_t len = 0;
+
+  for (int i = 0; i < tpl->count && len + 1 < cap; i++) {
+    const TemplateOp *op = &tpl->ops[i];
+    const char *src;
+    size_t n;
+
+    if (op->field) {
+      n = 0;
+      src = field ? field(ctx, op->field, scratch, sizeof scratch, &n) : NULL;
+      if (!src)
+        continue;
+    } else {
+      src = tpl->text + op->offset;
+      n = op->len;
+    }
+
+    if (n > cap - 1 - len)
+      n = cap - 1 - len;
+    memcpy(buf + len, src, n);
+    len += n;
+  }
+  buf[len] = '\0';
+
+  return len;
+}
+
+bool template_uses(const Template *tpl, char field) {
+  if (!tpl)
+    return false;
+  for (int i = 0; i < tpl->count; i++) {
+    if (tpl->ops[i].field == field)
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,239 @@
+/* src/text_measure.c */
+#include "include/text_measure.h"
+#include "include/config.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Printable ASCII, the pairs whose kerning is kept */
+#define ASCII_FIRST 0x20
+#define ASCII_COUNT 95
+#define KERNING_UNKNOWN SHRT_MIN
+
+typedef struct {
+  Uint32 ch;
+  bool used;
+  int advance;
+} CachedAdvance;
+
+struct TextMeasure {
+  TTF_Font *font;
+  int fixed_advance; /* of every printable ASCII glyph if the font is
+                      * fixed-pitch, 0 otherwise */
+  int ascii[128];
+  short kerning[ASCII_COUNT][ASCII_COUNT];
+
+  /* Open addressing by code point */
+  CachedAdvance cache[TEXT_MEASURE_CACHE_GLYPHS];
+  int cache_count;
+};
+
+/* Code point ranges that are only measured right after shaping: combining
+ * marks, joiners and the scripts whose glyphs change with their
+ * neighbours. Sorted */
+static const struct {
+  Uint32 first, last;
+} shaped_ranges[] = {
+    {0x0300, 0x036F},   /* combining diacritical marks */
+    {0x0483, 0x0489},   /* Cyrillic combining marks */
+    {0x0591, 0x08FF},   /* Hebrew points, Arabic, Syriac, Thaana, N'Ko */
+    {0x0900, 0x0DFF},   /* Indic scripts, Sinhala */
+    {0x0E00, 0x0FFF},   /* Thai, Lao, Tibetan */
+    {0x1000, 0x109F},   /* Myanmar */
+    {0x1100, 0x11FF},   /* Hangul Jamo */
+    {0x1700, 0x18AF},   /* Philippine scripts, Khmer, Mongolian */
+    {0x1A00, 0x1CFF},   /* Buginese to Vedic extensions */
+    {0x1DC0, 0x1DFF},   /* combining diacritical marks supplement */
+    {0x200B, 0x200F},   /* zero width space, joiners, direction marks */
+    {0x202A, 0x202E},   /* bidirectional embeddings */
+    {0x2066, 0x2069},   /* bidirectional isolates */
+    {0x20D0, 0x20FF},   /* combining marks for symbols */
+    {0xA800, 0xABFF},   /* Syloti Nagri to Meetei Mayek */
+    {0xD7B0, 0xD7FF},   /* Hangul Jamo extended-B */
+    {0xFB1D, 0xFDFF},   /* Hebrew and Arabic presentation forms */
+    {0xFE00, 0xFE0F},   /* variation selectors */
+    {0xFE20, 0xFE2F},   /* combining half marks */
+    {0xFE70, 0xFEFF},   /* Arabic presentation forms-B, byte order mark */
+    {0x10A00, 0x10A5F}, /* Kharoshthi */
+    {0x11000, 0x11FFF}, /* Brahmi and the other historic Indic scripts */
+    {0x1F1E6, 0x1F1FF}, /* regional indicators (flags) */
+    {0x1F3FB, 0x1F3FF}, /* skin tone modifiers */
+    {0xE0000, 0xE01EF}, /* tags, variation selectors supplement */
+};
+
+static bool needs_shaping(Uint32 ch) {
+  if (ch < shaped_ranges[0].first)
+    return false;
+
+  int lo = 0, hi = (int)(sizeof shaped_ranges / sizeof shaped_ranges[0]) - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (ch < shaped_ranges[mid].first)
+      hi = mid - 1;
+    else if (ch > shaped_ranges[mid].last)
+      lo = mid + 1;
+    else
+      return true;
+  }
+  return false;
+}
+
+static int font_advance(TTF_Font *font, Uint32 ch) {
+  int advance = 0;
+  if (!TTF_GetGlyphMetrics(font, ch, NULL, NULL, NULL, NULL, &advance))
+    return 0;
+  return advance;
+}
+
+TextMeasure *text_measure_create(TTF_Font *font) {
+  if (!font)
+    return NULL;
+
+  TextMeasure *tm = calloc(1, sizeof *tm);
+  if (!tm)
+    return NULL;
+  tm->font = font;
+
+  for (Uint32 ch = 0; ch < 128; ch++)
+    tm->ascii[ch] = font_advance(font, ch);
+  for (int a = 0; a < ASCII_COUNT; a++) {
+    for (int b = 0; b < ASCII_COUNT; b++)
+      tm->kerning[a][b] = KERNING_UNKNOWN;
+  }
+
+  /* Trust the flag only if the advances agree */
+  if (TTF_FontIsFixedWidth(font)) {
+    bool same = true;
+    for (int ch = ASCII_FIRST; ch < ASCII_FIRST + ASCII_COUNT; ch++)
+      same = same && tm->ascii[ch] == tm->ascii[ASCII_FIRST];
+    if (same)
+      tm->fixed_advance = tm->ascii[ASCII_FIRST];
+  }
+
+  return tm;
+}
+
+void text_measure_destroy(TextMeasure *tm) { free(tm); }
+
+static int glyph_advance(TextMeasure *tm, Uint32 ch) {
+  if (ch < 128)
+    return tm->ascii[ch];
+
+  unsigned i = (ch * 2654435761u) & (TEXT_MEASURE_CACHE_GLYPHS - 1);
+  while (tm->cache[i].used && tm->cache[i].ch != ch)
+    i = (i + 1) & (TEXT_MEASURE_CACHE_GLYPHS - 1);
+  if (tm->cache[i].used)
+    return tm->cache[i].advance;
+
+  /* Keep the table sparse enough for probing */
+  if (tm->cache_count >= TEXT_MEASURE_CACHE_GLYPHS * 3 / 4) {
+    memset(tm->cache, 0, sizeof tm->cache);
+    tm->cache_count = 0;
+    i = (ch * 2654435761u) & (TEXT_MEASURE_CACHE_GLYPHS - 1);
+  }
+
+  CachedAdvance *c = &tm->cache[i];
+  *c = (CachedAdvance){ch, true, font_advance(tm->font, ch)};
+  tm->cache_count++;
+  return c->advance;
+}
+
+static int glyph_kerning(TextMeasure *tm, Uint32 prev, Uint32 ch) {
+  int kerning = 0;
+  if (prev - ASCII_FIRST < ASCII_COUNT && ch - ASCII_FIRST < ASCII_COUNT) {
+    short *k = &tm->kerning[prev - ASCII_FIRST][ch - ASCII_FIRST];
+    if (*k == KERNING_UNKNOWN) {
+      if (!TTF_GetGlyphKerning(tm->font, prev, ch, &kerning))
+        kerning = 0;
+      *k = (short)kerning;
+    }
+    return *k;
+  }
+  if (!TTF_GetGlyphKerning(tm->font, prev, ch, &kerning))
+    return 0;
+  return kerning;
+}
+
+/* Length of the printable ASCII run text starts with */
+static size_t printable_run(const char *text, size_t len) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i below = _mm_set1_epi8(ASCII_FIRST - 1);
+  const __m128i above = _mm_set1_epi8(ASCII_FIRST + ASCII_COUNT);
+  for (; i + 16 <= len; i += 16) {
+    /* Bytes from 0x80 are negative, so below the lower bound */
+    __m128i v = _mm_loadu_si128((const __m128i *)(text + i));
+    __m128i ok =
+        _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above));
+    unsigned stop = ~(unsigned)_mm_movemask_epi8(ok) & 0xFFFF;
+    if (stop)
+      return i + (size_t)__builtin_ctz(stop);
+  }
+#endif
+  while (i < len && (unsigned char)text[i] - ASCII_FIRST < ASCII_COUNT)
+    i++;
+  return i;
+}
+
+/* Fixed-pitch font: printable ASCII runs by their length, the rest by the
+ * advance of each code point; no kerning. -1 if the text needs shaping */
+static int measure_fixed(TextMeasure *tm, const char *text, size_t len) {
+  int width = 0;
+  while (len > 0) {
+    size_t run = printable_run(text, len);
+    width += (int)run * tm->fixed_advance;
+    text += run;
+    len -= run;
+    if (len == 0)
+      break;
+
+    Uint32 ch = SDL_StepUTF8(&text, &len);
+    if (needs_shaping(ch))
+      return -1;
+    width += glyph_advance(tm, ch);
+  }
+  return width;
+}
+
+/* Any other font: advance and pair kerning of each code point. -1 if the
+ * text needs shaping */
+static int measure_proportional(TextMeasure *tm, const char *text,
+                                size_t len) {
+  int width = 0;
+  Uint32 prev = 0;
+  while (len > 0) {
+    Uint32 ch;
+    if ((unsigned char)*text < 0x80) {
+      ch = (unsigned char)*text++;
+      len--;
+    } else {
+      ch = SDL_StepUTF8(&text, &len);
+      if (needs_shaping(ch))
+        return -1;
+    }
+    if (prev)
+      width += glyph_kerning(tm, prev, ch);
+    width += glyph_advance(tm, ch);
+    prev = ch;
+  }
+  return width;
+}
+
+int text_measure_width(TextMeasure *tm, const char *text, size_t len) {
+  if (!tm || !text || len == 0)
+    return 0;
+
+  int width = tm->fixed_advance ? measure_fixed(tm, text, len)
+                                : measure_proportional(tm, text, len);
+  if (width >= 0)
+    return width;
+
+  int h = 0;
+  if (!TTF_GetStringSize(tm->font, text, len, &width, &h))
+    return 0;
+  return width;
+}
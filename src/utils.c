@@ -14,9 +14,8 @@ bool SDL_SetRenderDrawColour(SDL_Renderer *renderer, SDL_Color color) {
 }
 
 /* Unified cell update with width calculation.
- * This function updates both the cell text AND updates g_max_col_widths
- * if needed. This ensures headers, data rows, and dynamically updated cells
- * all contribute to column width calculations.
+ * This function updates both the cell text AND its measured size. Column
+ * widths come from the width statistics of g_table.
  */
 void set_cell_with_width_update(int row, int col, const char *text) {
   if (row < 0 || row >= g_rows || col < 0 || col >= g_cols)
@@ -31,25 +30,9 @@ void set_cell_with_width_update(int row, int col, const char *text) {
   }
 
   size_t len = strlen(g_grid[row][col].text);
-  bool success = TTF_GetStringSize(g_font, g_grid[row][col].text, len,
-                                   &g_grid[row][col].text_width,
-                                   &g_grid[row][col].text_height);
-  if (!success) {
-    g_grid[row][col].text_width = 0;
-    g_grid[row][col].text_height = 0;
-    return;
-  }
-
-  /* Update max column width if this cell's text is wider */
-  if (g_max_col_widths && col < g_cols) {
-    g_max_col_widths[col] =
-        SDL_max(g_max_col_widths[col], g_grid[row][col].text_width);
-  }
-
-  /* Mark table widths as dirty so they get recalculated */
-  if (g_table) {
-    table_mark_dirty(g_table, true, false);
-  }
+  g_grid[row][col].text_width =
+      text_measure_width(g_measure, g_grid[row][col].text, len);
+  g_grid[row][col].text_height = TTF_GetFontHeight(g_font);
 }
 
 /* Legacy wrapper for backwards compatibility.
@@ -1,220 +1,359 @@
 #include "include/virtual_scroll.h"
 #include "include/config.h"
 #include "include/globals.h"
-#include <math.h>
+#include "include/layout.h"
+#include "include/table_model.h"
 #include <stdlib.h>
 #include <string.h>
 
 VirtualScrollState *vscroll_init(int cols) {
-  VirtualScrollState *vs = malloc(sizeof(VirtualScrollState));
+  VirtualScrollState *vs = calloc(1, sizeof(VirtualScrollState));
   if (!vs)
     return NULL;
 
-  vs->buffer = malloc(VSCROLL_BUFFER_SIZE * sizeof(Cell *));
-  if (!vs->buffer) {
-    free(vs);
-    return NULL;
-  }
-
-  for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++) {
-    vs->buffer[i] = calloc(cols, sizeof(Cell));
-    if (!vs->buffer[i]) {
-      for (int j = 0; j < i; j++)
-        free(vs->buffer[j]);
-      free(vs->buffer);
-      free(vs);
-      return NULL;
-    }
-  }
-
-  vs->texture_cache =
-      malloc(VSCROLL_BUFFER_SIZE * cols * sizeof(SDL_Texture *));
-  vs->texture_valid = malloc(VSCROLL_BUFFER_SIZE * cols * sizeof(bool));
-
-  if (!vs->texture_cache || !vs->texture_valid) {
-    free(vs->texture_cache);
-    free(vs->texture_valid);
-    for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++)
-      free(vs->buffer[i]);
+  /* The cells of the slots come with the first column window */
+  vs->buffer = calloc(VSCROLL_BUFFER_SIZE, sizeof(Cell *));
+  vs->text_at = calloc(VSCROLL_BUFFER_SIZE, sizeof(size_t *));
+  vs->buffer_rows = malloc(VSCROLL_BUFFER_SIZE * sizeof(int64_t));
+  vs->slot_text = calloc(VSCROLL_BUFFER_SIZE, sizeof(char *));
+  vs->slot_text_cap = calloc(VSCROLL_BUFFER_SIZE, sizeof(size_t));
+  vs->slot_text_used = calloc(VSCROLL_BUFFER_SIZE, sizeof(size_t));
+  vs->slot_text_stale = calloc(VSCROLL_BUFFER_SIZE, sizeof(bool));
+  if (!vs->buffer || !vs->text_at || !vs->buffer_rows || !vs->slot_text ||
+      !vs->slot_text_cap || !vs->slot_text_used || !vs->slot_text_stale) {
     free(vs->buffer);
+    free(vs->text_at);
+    free(vs->buffer_rows);
+    free(vs->slot_text);
+    free(vs->slot_text_cap);
+    free(vs->slot_text_used);
+    free(vs->slot_text_stale);
     free(vs);
     return NULL;
   }
 
-  memset(vs->texture_cache, 0,
-         VSCROLL_BUFFER_SIZE * cols * sizeof(SDL_Texture *));
-  memset(vs->texture_valid, 0, VSCROLL_BUFFER_SIZE * cols * sizeof(bool));
+  for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++)
+    vs->buffer_rows[i] = -1;
 
+  vs->cols = cols;
+  vs->col_begin = 0;
+  vs->col_count = 0;
+  vs->col_capacity = 0;
   vs->buffer_start_row = 0;
   vs->buffer_count = 0;
   vs->desired_start_row = 0;
-  vs->needs_reload = true;
   vs->total_virtual_rows = 0;
 
   return vs;
 }
 
+/* Drop the cells of a slot, keeping its text buffer for what comes next */
+static void vscroll_clear_slot(VirtualScrollState *vs, int slot) {
+  for (int i = 0; i < vs->col_count; i++)
+    vs->buffer[slot][i] = (Cell){0};
+  vs->slot_text_used[slot] = 0;
+  vs->slot_text_stale[slot] = false;
+}
+
+/* Mark a slot empty; its text buffer is kept for the next row */
+static void vscroll_evict_slot(VirtualScrollState *vs, int slot) {
+  vscroll_clear_slot(vs, slot);
+  vs->buffer_rows[slot] = -1;
+}
+
 void vscroll_cleanup(VirtualScrollState *vs) {
   if (!vs)
     return;
 
-  vscroll_invalidate_all_textures(vs);
+  for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++) {
+    free(vs->buffer[i]);
+    free(vs->text_at[i]);
+    free(vs->slot_text[i]);
+  }
+  free(vs->buffer);
+  free(vs->text_at);
+  free(vs->buffer_rows);
+  free(vs->slot_text);
+  free(vs->slot_text_cap);
+  free(vs->slot_text_used);
+  free(vs->slot_text_stale);
+  free(vs->slot_offsets);
+  free(vs->col_index);
+  free(vs);
+}
 
-  if (vs->buffer) {
-    for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++) {
-      if (vs->buffer[i]) {
-        for (int c = 0; c < g_cols; c++) {
-          if (vs->buffer[i][c].text) {
-            free(vs->buffer[i][c].text);
-            vs->buffer[i][c].text = NULL;
-          }
-        }
-        free(vs->buffer[i]);
-      }
+/* Make room for count cached columns in every slot */
+static bool vscroll_reserve_cols(VirtualScrollState *vs, int count) {
+  if (count <= vs->col_capacity)
+    return true;
+
+  for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++) {
+    Cell *cells = realloc(vs->buffer[i], (size_t)count * sizeof *cells);
+    if (!cells)
+      return false;
+    vs->buffer[i] = cells;
+    size_t *at = realloc(vs->text_at[i], (size_t)count * sizeof *at);
+    if (!at)
+      return false;
+    vs->text_at[i] = at;
+  }
+  size_t *offsets =
+      realloc(vs->slot_offsets, (size_t)count * sizeof *offsets);
+  if (!offsets)
+    return false;
+  vs->slot_offsets = offsets;
+  int *index = realloc(vs->col_index, (size_t)count * sizeof *index);
+  if (!index)
+    return false;
+  vs->col_index = index;
+
+  vs->col_capacity = count;
+  return true;
+}
+
+/* Cache columns [begin, end) from now on. Cells of columns in both
+ * windows move to their new place, the columns that entered are left to
+ * be formatted on the next miss */
+static void vscroll_set_columns(VirtualScrollState *vs, int begin, int end) {
+  if (!vscroll_reserve_cols(vs, end - begin))
+    return; /* keep the old window */
+
+  int keep_begin = SDL_max(begin, vs->col_begin);
+  int keep_end = SDL_min(end, vs->col_begin + vs->col_count);
+  int keep = SDL_max(0, keep_end - keep_begin);
+  bool dropped = keep < vs->col_count;
+
+  for (int slot = 0; slot < VSCROLL_BUFFER_SIZE; slot++) {
+    if (vs->buffer_rows[slot] == -1)
+      continue;
+    Cell *cells = vs->buffer[slot];
+    size_t *at = vs->text_at[slot];
+    if (keep == 0) {
+      for (int i = 0; i < end - begin; i++)
+        cells[i] = (Cell){0};
+      vs->slot_text_used[slot] = 0;
+      vs->slot_text_stale[slot] = false;
+      continue;
     }
-    free(vs->buffer);
+
+    memmove(cells + keep_begin - begin, cells + keep_begin - vs->col_begin,
+            (size_t)keep * sizeof *cells);
+    memmove(at + keep_begin - begin, at + keep_begin - vs->col_begin,
+            (size_t)keep * sizeof *at);
+    for (int i = 0; i < keep_begin - begin; i++)
+      cells[i] = (Cell){0};
+    for (int i = keep_end - begin; i < end - begin; i++)
+      cells[i] = (Cell){0};
+    if (dropped)
+      vs->slot_text_stale[slot] = true;
   }
 
-  free(vs->texture_cache);
-  free(vs->texture_valid);
-  free(vs);
+  vs->col_begin = begin;
+  vs->col_count = end - begin;
 }
 
-void vscroll_update_buffer_position(VirtualScrollState *vs, float view_y,
-                                    float content_h, float row_height) {
-  if (!vs)
+void vscroll_update_buffer_position(VirtualScrollState *vs,
+                                    const SizeAlloc *sa, double offset_x,
+                                    double offset_y) {
+  if (!vs || !sa)
     return;
 
-  float line_w = GRID_LINE_WIDTH;
-  float row_full = row_height + line_w;
-
-  int first_visible_row = (int)floorf(g_offset_y / row_full);
+  /* Move the column window once the visible columns leave it, with
+   * VSCROLL_PREFETCH_COLS to spare on both sides */
+  int first_col = layout_col_at(sa, offset_x);
+  int last_col = SDL_min(layout_col_at(sa, offset_x + sa->content_w),
+                         vs->cols - 1);
+  if (first_col >= 0 && first_col <= last_col &&
+      (first_col < vs->col_begin ||
+       last_col >= vs->col_begin + vs->col_count))
+    vscroll_set_columns(vs, SDL_max(0, first_col - VSCROLL_PREFETCH_COLS),
+                        SDL_min(vs->cols,
+                                last_col + 1 + VSCROLL_PREFETCH_COLS));
+
+  int64_t first_visible_row = layout_row_at(sa, offset_y, NULL);
   if (first_visible_row < 0)
     first_visible_row = 0;
   /* ЗАЩИТА: не можем начинать дальше последней строки */
   if (first_visible_row >= vs->total_virtual_rows)
     first_visible_row =
         vs->total_virtual_rows > 0 ? vs->total_virtual_rows - 1 : 0;
+  int64_t last_visible_row = SDL_max(
+      first_visible_row, layout_row_at(sa, offset_y + sa->content_h, NULL));
 
-  int visible_count = (int)ceilf(content_h / row_full) + 1;
   int prefetch_before = VSCROLL_PREFETCH;
   int prefetch_after = VSCROLL_PREFETCH;
 
-  int desired_start = first_visible_row - prefetch_before;
-  int desired_end = first_visible_row + visible_count + prefetch_after;
+  int64_t desired_start = first_visible_row - prefetch_before;
+  int64_t desired_end = last_visible_row + 1 + prefetch_after;
 
   if (desired_start < 0)
     desired_start = 0;
   if (desired_end > vs->total_virtual_rows)
     desired_end = vs->total_virtual_rows;
+  /* The ring holds at most VSCROLL_BUFFER_SIZE distinct rows */
+  if (desired_end - desired_start > VSCROLL_BUFFER_SIZE)
+    desired_end = desired_start + VSCROLL_BUFFER_SIZE;
 
   vs->desired_start_row = desired_start;
 
-  int desired_count = desired_end - desired_start;
-
-  if (vs->desired_start_row < vs->buffer_start_row ||
-      vs->desired_start_row + desired_count >
-          vs->buffer_start_row + vs->buffer_count ||
-      desired_count > VSCROLL_BUFFER_SIZE) {
-    vs->needs_reload = true;
+  /* Evict only the rows of the old window that are not in the new one */
+  int64_t old_start = vs->buffer_start_row;
+  int64_t old_end = old_start + vs->buffer_count;
+  for (int64_t row = old_start; row < old_end; row++) {
+    if (row >= desired_start && row < desired_end) {
+      row = desired_end - 1; /* skip the overlap */
+      continue;
+    }
+    int slot = (int)(row % VSCROLL_BUFFER_SIZE);
+    if (vs->buffer_rows[slot] == row)
+      vscroll_evict_slot(vs, slot);
   }
-}
 
-void vscroll_load_from_grid(VirtualScrollState *vs, int start_row, int count) {
-  if (!vs)
-    return;
-  if (count > VSCROLL_BUFFER_SIZE)
-    count = VSCROLL_BUFFER_SIZE;
-  if (start_row < 0)
-    start_row = 0;
-  if (start_row + count > vs->total_virtual_rows)
-    count = vs->total_virtual_rows - start_row;
-
-  SDL_LockMutex(g_grid_mutex);
+  vs->buffer_start_row = desired_start;
+  vs->buffer_count = (int)SDL_max(0, desired_end - desired_start);
+}
 
-  vscroll_invalidate_all_textures(vs);
+/* Grow the text buffer of a slot to at least `need` bytes */
+static bool vscroll_reserve_text(VirtualScrollState *vs, int slot,
+                                 size_t need) {
+  if (need <= vs->slot_text_cap[slot])
+    return true;
+
+  size_t new_cap = SDL_max(vs->slot_text_cap[slot] * 2, 64);
+  while (new_cap < need)
+    new_cap *= 2;
+  char *grown = realloc(vs->slot_text[slot], new_cap);
+  if (!grown)
+    return false;
+  vs->slot_text[slot] = grown;
+  vs->slot_text_cap[slot] = new_cap;
+  return true;
+}
 
-  for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++) {
-    for (int c = 0; c < g_cols; c++) {
-      if (vs->buffer[i][c].text) {
-        free(vs->buffer[i][c].text);
-        vs->buffer[i][c].text = NULL;
+/* Format the columns of a row its slot has no cells for yet, appended to
+ * the text buffer of the slot. Data rows are fetched straight into the
+ * buffer with one table_format_cells() call; the buffer only grows */
+static bool vscroll_format_slot(VirtualScrollState *vs, int slot,
+                                int64_t virtual_row) {
+  Cell *cells = vs->buffer[slot];
+  size_t *at = vs->text_at[slot];
+  size_t *offsets = vs->slot_offsets;
+  int *cols = vs->col_index;
+
+  int count = 0;
+  for (int i = 0; i < vs->col_count; i++) {
+    if (!cells[i].text)
+      cols[count++] = vs->col_begin + i;
+  }
+  if (count == 0)
+    return true;
+
+  size_t used = vs->slot_text_used[slot];
+  if (virtual_row == 0) {
+    char text[TABLE_CELL_MAX];
+    for (int i = 0; i < count; i++) {
+      size_t len = table_format_header(g_table, cols[i], text, sizeof text);
+      if (used + len + 1 > vs->slot_text_cap[slot] &&
+          vs->slot_text_stale[slot]) {
+        /* Reuse the text of the columns that left instead of growing */
+        vscroll_clear_slot(vs, slot);
+        return vscroll_format_slot(vs, slot, virtual_row);
+      }
+      if (!vscroll_reserve_text(vs, slot, used + len + 1)) {
+        vscroll_clear_slot(vs, slot); /* cells may point into moved text */
+        return false;
       }
+      memcpy(vs->slot_text[slot] + used, text, len + 1);
+      offsets[i] = used;
+      used += len + 1;
     }
-  }
-
-  for (int i = 0; i < count; i++) {
-    int src_row = start_row + i;
-    if (src_row < 0 || src_row >= g_rows)
-      continue;
-
-    int buf_idx = i;
-    for (int c = 0; c < g_cols; c++) {
-      if (g_grid[src_row] && g_grid[src_row][c].text) {
-        vs->buffer[buf_idx][c].text =
-            malloc(strlen(g_grid[src_row][c].text) + 1);
-        if (vs->buffer[buf_idx][c].text) {
-          strcpy(vs->buffer[buf_idx][c].text, g_grid[src_row][c].text);
+  } else {
+    for (;;) {
+      size_t room = vs->slot_text_cap[slot] - used;
+      if (room > 0 &&
+          table_format_cells(g_table, virtual_row - 1, virtual_row, cols,
+                             count, vs->slot_text[slot] + used, room,
+                             offsets) == 1) {
+        for (int i = 0; i < count; i++)
+          offsets[i] += used;
+        const char *last = vs->slot_text[slot] + offsets[count - 1];
+        used = offsets[count - 1] + strlen(last) + 1;
+        break;
+      }
+      /* Not formatted: either the row is gone, e.g. after a rescan, or it
+       * needs more room, never more than count * TABLE_CELL_MAX. Only the
+       * latter grows the buffer */
+      if (virtual_row > table_get_row_count(g_table) ||
+          room >= (size_t)count * TABLE_CELL_MAX) {
+        if (!vscroll_reserve_text(vs, slot, used + 1)) {
+          vscroll_clear_slot(vs, slot);
+          return false;
         }
+        vs->slot_text[slot][used] = '\0';
+        for (int i = 0; i < count; i++)
+          offsets[i] = used;
+        used++;
+        break;
       }
-      if (g_grid[src_row]) {
-        vs->buffer[buf_idx][c].text_width = g_grid[src_row][c].text_width;
-        vs->buffer[buf_idx][c].text_height = g_grid[src_row][c].text_height;
+      if (vs->slot_text_stale[slot]) {
+        vscroll_clear_slot(vs, slot);
+        return vscroll_format_slot(vs, slot, virtual_row);
+      }
+      if (!vscroll_reserve_text(vs, slot, vs->slot_text_cap[slot] + 1)) {
+        vscroll_clear_slot(vs, slot);
+        return false;
       }
     }
   }
+  vs->slot_text_used[slot] = used;
 
-  vs->buffer_start_row = start_row;
-  vs->buffer_count = count;
-  vs->needs_reload = false;
-
-  SDL_UnlockMutex(g_grid_mutex);
+  for (int i = 0; i < count; i++) {
+    int pos = cols[i] - vs->col_begin;
+    at[pos] = offsets[i];
+    cells[pos].text_width = -1;
+    cells[pos].text_height = -1;
+  }
+  /* The buffer may have moved: point every cell into it again */
+  for (int i = 0; i < vs->col_count; i++)
+    cells[i].text = vs->slot_text[slot] + at[i];
+  return true;
 }
 
-Cell *vscroll_get_cell(VirtualScrollState *vs, int virtual_row, int col) {
-  if (!vs || col < 0 || col >= g_cols)
-    return NULL;
-
-  int buf_idx = virtual_row - vs->buffer_start_row;
-  if (buf_idx < 0 || buf_idx >= vs->buffer_count)
+Cell *vscroll_get_cell(VirtualScrollState *vs, int64_t virtual_row, int col) {
+  if (!vs || virtual_row < 0 || col < vs->col_begin ||
+      col >= vs->col_begin + vs->col_count)
     return NULL;
 
-  return &vs->buffer[buf_idx][col];
-}
-
-SDL_Texture *vscroll_get_cached_texture(VirtualScrollState *vs, int buf_idx,
-                                        int col) {
-  if (!vs || buf_idx < 0 || buf_idx >= VSCROLL_BUFFER_SIZE || col < 0 ||
-      col >= g_cols)
-    return NULL;
+  int slot = (int)(virtual_row % VSCROLL_BUFFER_SIZE);
+  if (vs->buffer_rows[slot] != virtual_row) {
+    /* Miss: the slot belongs to another row, start over with this one */
+    vscroll_evict_slot(vs, slot);
+    vs->buffer_rows[slot] = virtual_row;
+  }
 
-  int idx = buf_idx * g_cols + col;
-  if (!vs->texture_valid[idx])
+  /* Format what the slot lacks: the whole row, or the columns that
+   * entered the window since */
+  Cell *cell = &vs->buffer[slot][col - vs->col_begin];
+  if (!cell->text && !vscroll_format_slot(vs, slot, virtual_row))
     return NULL;
-
-  return vs->texture_cache[idx];
+  return cell;
 }
 
-void vscroll_set_cached_texture(VirtualScrollState *vs, int buf_idx, int col,
-                                SDL_Texture *tex) {
-  if (!vs || buf_idx < 0 || buf_idx >= VSCROLL_BUFFER_SIZE || col < 0 ||
-      col >= g_cols)
+void vscroll_invalidate_row(VirtualScrollState *vs, int64_t virtual_row) {
+  if (!vs || virtual_row < 0)
     return;
 
-  int idx = buf_idx * g_cols + col;
-  vs->texture_cache[idx] = tex;
-  vs->texture_valid[idx] = (tex != NULL);
+  int slot = (int)(virtual_row % VSCROLL_BUFFER_SIZE);
+  if (vs->buffer_rows[slot] == virtual_row)
+    vscroll_evict_slot(vs, slot);
 }
 
-void vscroll_invalidate_all_textures(VirtualScrollState *vs) {
+void vscroll_invalidate_all(VirtualScrollState *vs) {
   if (!vs)
     return;
 
-  for (int i = 0; i < VSCROLL_BUFFER_SIZE * g_cols; i++) {
-    if (vs->texture_cache[i]) {
-      SDL_DestroyTexture(vs->texture_cache[i]);
-      vs->texture_cache[i] = NULL;
-    }
-    vs->texture_valid[i] = false;
+  for (int i = 0; i < VSCROLL_BUFFER_SIZE; i++) {
+    if (vs->buffer_rows[i] != -1)
+      vscroll_evict_slot(vs, i);
   }
-}
\ No newline at end of file
+}